@@ -0,0 +1,239 @@
+/* Microbenchmarks for the hot paths of the emulator, run with make bench.
+ *
+ * Every benchmark runs its operation in batches that double in size until a
+ * batch takes at least MIN_BATCH_NS, and that batch is the one reported. The
+ * output is one tab separated line per benchmark under a header line, so that
+ * runs can be kept and compared:
+ *
+ *   benchmark  ops  ns_per_op  ops_per_sec
+ *
+ * an op is one call for the single function benchmarks, one full display for
+ * the pixel expansion and one emulated instruction for the frame benchmarks.
+ * Pass a string as the first argument to run only the benchmarks whose name
+ * contains it.
+ */
+
+#include "../src/blit.h"
+#include "../src/chip_instructions.h"
+#include "../src/helpers.h"
+#include "../src/libchip8.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+enum {
+    MIN_BATCH_NS = 200000000,
+    /* instructions per frame in the frame benchmarks, 100 times the default */
+    BENCH_FREQUENCY = 6000000,
+};
+
+/* synthetic ROMs, each an endless loop exercising one kind of instruction */
+// clang-format off
+static const uint8_t rom_alu[] = {
+    0x60, 0x01,  /* 200: LD V0, 0x01 */
+    0x61, 0x03,  /* 202: LD V1, 0x03 */
+    0x80, 0x14,  /* 204: ADD V0, V1 */
+    0x81, 0x05,  /* 206: SUB V1, V0 */
+    0x82, 0x13,  /* 208: XOR V2, V1 */
+    0x83, 0x06,  /* 20A: SHR V3, V0 */
+    0x72, 0x05,  /* 20C: ADD V2, 0x05 */
+    0x12, 0x04,  /* 20E: JP 0x204 */
+};
+
+/* I is reloaded every time round and V2 masked, so the sprite stays in the
+ * first 0x4F bytes of memory */
+static const uint8_t rom_sprite[] = {
+    0x63, 0x3F,  /* 200: LD V3, 0x3F */
+    0xA0, 0x00,  /* 202: LD I, 0x000 */
+    0xF2, 0x1E,  /* 204: ADD I, V2 */
+    0xD0, 0x1F,  /* 206: DRW V0, V1, 15 */
+    0x70, 0x05,  /* 208: ADD V0, 0x05 */
+    0x71, 0x03,  /* 20A: ADD V1, 0x03 */
+    0x72, 0x01,  /* 20C: ADD V2, 0x01 */
+    0x82, 0x32,  /* 20E: AND V2, V3 */
+    0x12, 0x02,  /* 210: JP 0x202 */
+};
+
+static const uint8_t rom_bcd[] = {
+    0xA3, 0x00,  /* 200: LD I, 0x300 */
+    0xF0, 0x33,  /* 202: LD B, V0 */
+    0xF2, 0x65,  /* 204: LD V2, [I] */
+    0x70, 0x07,  /* 206: ADD V0, 0x07 */
+    0x12, 0x02,  /* 208: JP 0x202 */
+};
+
+static const uint8_t rom_call[] = {
+    0x22, 0x06,  /* 200: CALL 0x206 */
+    0x70, 0x01,  /* 202: ADD V0, 0x01 */
+    0x12, 0x00,  /* 204: JP 0x200 */
+    0x22, 0x0A,  /* 206: CALL 0x20A */
+    0x00, 0xEE,  /* 208: RET */
+    0x71, 0x01,  /* 20A: ADD V1, 0x01 */
+    0x00, 0xEE,  /* 20C: RET */
+};
+// clang-format on
+
+struct rom {
+    const char* name;
+    const uint8_t* data;
+    size_t size;
+};
+
+static const struct rom roms[] = {
+    {"alu", rom_alu, sizeof(rom_alu)},
+    {"sprite", rom_sprite, sizeof(rom_sprite)},
+    {"bcd", rom_bcd, sizeof(rom_bcd)},
+    {"call", rom_call, sizeof(rom_call)},
+};
+
+/* runs the operation n times, returns the number of ops done */
+typedef uint64_t (*bench_fn)(struct state* s, uint64_t n);
+
+/* the result of the last run is kept here, so that nothing is optimised away */
+static volatile uint64_t sink;
+
+static uint64_t bench_fetch(struct state* s, uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++) {
+        s->chip8->program_counter = PROGRAM_LOAD_ADDRESS + ((i & 7) << 1);
+        fetch(s);
+    }
+
+    sink = s->ops->opcode;
+    return n;
+}
+
+static uint64_t bench_decode_execute(struct state* s, uint64_t n)
+{
+    /* fetch once, then execute the same ADD V0, V1 over and over */
+    s->chip8->program_counter = PROGRAM_LOAD_ADDRESS + 4;
+    fetch(s);
+
+    for (uint64_t i = 0; i < n; i++)
+        decode_execute(s);
+
+    sink = s->chip8->registers[0];
+    return n;
+}
+
+static uint64_t bench_dxyn(struct state* s, uint64_t n)
+{
+    /* DRW V0, V1, 15 from the sprite ROM, moving across the display */
+    s->chip8->program_counter = PROGRAM_LOAD_ADDRESS + 2;
+    fetch(s);
+
+    for (uint64_t i = 0; i < n; i++) {
+        s->chip8->registers[0] = i * 5;
+        s->chip8->registers[1] = i * 3;
+        instruction_dxyn(s);
+    }
+
+    sink = s->chip8->registers[0xF];
+    return n;
+}
+
+static uint64_t bench_expand(struct state* s, uint64_t n)
+{
+    static uint32_t pixels[DISPLAY_SIZE];
+
+    for (uint64_t i = 0; i < n; i++)
+        for (int h = 0; h < DISPH; h++)
+            expand_row(&pixels[h * DISPW], s->chip8->display[h] ^ i, 0x61afefff, 0x282c34ff);
+
+    sink = pixels[n & (DISPLAY_SIZE - 1)];
+    return n;
+}
+
+static uint64_t bench_frames(struct state* s, uint64_t n)
+{
+    uint64_t start = s->cycles;
+
+    for (uint64_t i = 0; i < n; i++)
+        chip8_run_frame(s);
+
+    return s->cycles - start;
+}
+
+/* runs fn in doubling batches until one is long enough to time, then
+ * prints its line */
+static void run_bench(const char* name, const char* filter, bench_fn fn, struct state* s)
+{
+    if (filter && strstr(name, filter) == NULL)
+        return;
+
+    for (uint64_t n = 1;; n *= 2) {
+        uint64_t start = host_time_ns();
+        uint64_t ops = fn(s, n);
+        uint64_t elapsed = host_time_ns() - start;
+
+        if (elapsed < MIN_BATCH_NS)
+            continue;
+
+        fprintf(stdout, "%s\t%" PRIu64 "\t%.3f\t%.0f\n", name, ops, (double)elapsed / ops, ops * 1e9 / elapsed);
+        fflush(stdout);
+        return;
+    }
+}
+
+/* creates an instance running rom on core, returns NULL when the core is
+ * not available on this host */
+static struct state* create_instance(const struct rom* rom, uint8_t core)
+{
+    struct chip8_launch_data data = {.frequency = BENCH_FREQUENCY, .seed = 1};
+    struct state* s = chip8_create(&data);
+
+    if (s == NULL) {
+        fprintf(stderr, "chip8-bench: out of memory\n");
+        return NULL;
+    }
+
+    chip8_load_rom_mem(s, rom->data, rom->size);
+
+    if (chip8_set_core(s, core) == BAD_RETURN_VALUE) {
+        fprintf(stderr, "chip8-bench: the %s core is not available, skipped\n", core_names[core]);
+        chip8_destroy(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : NULL;
+    char name[64];
+
+    fprintf(stdout, "benchmark\tops\tns_per_op\tops_per_sec\n");
+
+    struct state* s = create_instance(&roms[0], CORE_SWITCH);
+    if (s == NULL)
+        return 1;
+
+    run_bench("fetch", filter, bench_fetch, s);
+    run_bench("decode_execute", filter, bench_decode_execute, s);
+    chip8_destroy(s);
+
+    s = create_instance(&roms[1], CORE_SWITCH);
+    if (s == NULL)
+        return 1;
+
+    run_bench("instruction_dxyn", filter, bench_dxyn, s);
+    run_bench("expand_display", filter, bench_expand, s);
+    chip8_destroy(s);
+
+    /* the AOT core needs a library built for the ROM, it is not measured */
+    for (size_t r = 0; r < sizeof(roms) / sizeof(roms[0]); r++) {
+        for (uint8_t core = CORE_SWITCH; core < CORE_AOT; core++) {
+            s = create_instance(&roms[r], core);
+            if (s == NULL)
+                continue;
+
+            snprintf(name, sizeof(name), "frame_%s_%s", roms[r].name, core_names[core]);
+            run_bench(name, filter, bench_frames, s);
+            chip8_destroy(s);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,627 @@
+#define _DEFAULT_SOURCE
+
+#include "aot.h"
+#include "helpers.h"
+#include "idle.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__)
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* the view of the machine the generated code works on. the same field list
+ * is used to define the struct here and is written into the generated source */
+#define AOT_ENV_FIELDS \
+    uint8_t* V;        \
+    uint8_t* memory;   \
+    uint16_t* I;       \
+    uint16_t* PC;      \
+    uint8_t* DT;       \
+    uint8_t* ST;       \
+    uint8_t quirks;    \
+    void* state;       \
+    void (*step)(void* state);
+
+#define STRINGIFY(x) #x
+#define EXPAND_STRINGIFY(x) STRINGIFY(x)
+
+struct aot_env {
+    AOT_ENV_FIELDS
+};
+
+typedef uint32_t (*aot_block)(struct aot_env* e);
+
+struct aot_entry {
+    uint16_t address;
+    uint16_t length;
+    aot_block fn;
+};
+
+// clang-format off
+enum AOT_CONSTANTS {
+    /* bumped whenever struct aot_env or struct aot_entry change */
+    AOT_ABI_VERSION = 1,
+    MAX_BLOCK_INSTRUCTIONS = 256,
+};
+// clang-format on
+
+struct aot {
+    void* handle;
+    aot_block blocks[MEMSIZE];
+    uint16_t block_len[MEMSIZE];
+    uint16_t block_end[MEMSIZE];
+    /* one bit per byte of chip8 memory that is part of a native block */
+    uint64_t covered[MEMSIZE / 64];
+    uint32_t loaded;
+    uint32_t invalidated;
+};
+
+/* FNV-1a over the ROM, used to match a shared object with the loaded ROM */
+static uint32_t rom_hash(const uint8_t* rom, int size)
+{
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < size; i++) {
+        hash ^= rom[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* writes the C statements for the instruction at address. returns TRUE when
+ * the instruction ends the block, in which case a return has been written */
+static Bool emit_instruction(FILE* out, uint16_t opcode, uint16_t address, uint32_t count)
+{
+    const uint16_t NNN = opcode & 0x0fff;
+    const uint8_t NN = opcode & 0xff;
+    const uint8_t X = (opcode >> 8) & 0xf;
+    const uint8_t Y = (opcode >> 4) & 0xf;
+    const uint16_t next = address + 2;
+
+    switch (opcode >> 12) {
+        case 0x1:
+            fprintf(out, "    *e->PC = 0x%03x;\n    return %u;\n", NNN, count);
+            return TRUE;
+
+        case 0x3:
+        case 0x4:
+            fprintf(out, "    *e->PC = (V[%u] %s %u) ? 0x%03x : 0x%03x;\n    return %u;\n", X,
+                    (opcode >> 12) == 0x3 ? "==" : "!=", NN, next + 2, next, count);
+            return TRUE;
+
+        case 0x5:
+        case 0x9:
+            fprintf(out, "    *e->PC = (V[%u] %s V[%u]) ? 0x%03x : 0x%03x;\n    return %u;\n", X,
+                    (opcode >> 12) == 0x5 ? "==" : "!=", Y, next + 2, next, count);
+            return TRUE;
+
+        case 0x6:
+            fprintf(out, "    V[%u] = %u;\n", X, NN);
+            return FALSE;
+
+        case 0x7:
+            fprintf(out, "    V[%u] += %u;\n", X, NN);
+            return FALSE;
+
+        case 0x8:
+            switch (opcode & 0xf) {
+                case 0x0:
+                    fprintf(out, "    V[%u] = V[%u];\n", X, Y);
+                    return FALSE;
+
+                case 0x1:
+                    fprintf(out, "    V[%u] |= V[%u];\n", X, Y);
+                    return FALSE;
+
+                case 0x2:
+                    fprintf(out, "    V[%u] &= V[%u];\n", X, Y);
+                    return FALSE;
+
+                case 0x3:
+                    fprintf(out, "    V[%u] ^= V[%u];\n", X, Y);
+                    return FALSE;
+
+                case 0x4:
+                    fprintf(out, "    V[15] = (V[%u] > 255 - V[%u]);\n    V[%u] += V[%u];\n", X, Y, X, Y);
+                    return FALSE;
+
+                /* the flag is written before the operands are read, exactly like
+                 * chip_instructions.h does, VF can be one of them */
+                case 0x5:
+                    fprintf(out,
+                            "    V[15] = 1;\n"
+                            "    if (V[%u] < V[%u])\n        V[15] = 0;\n"
+                            "    V[%u] -= V[%u];\n",
+                            X, Y, X, Y);
+                    return FALSE;
+
+                case 0x6:
+                    fprintf(out,
+                            "    V[15] = 0;\n"
+                            "    { uint8_t r = e->quirks ? V[%u] : V[%u]; V[15] = r & 1; V[%u] = r >> 1; }\n",
+                            Y, X, X);
+                    return FALSE;
+
+                case 0x7:
+                    fprintf(out,
+                            "    V[15] = 1;\n"
+                            "    if (V[%u] < V[%u])\n        V[15] = 0;\n"
+                            "    V[%u] = V[%u] - V[%u];\n",
+                            Y, X, X, Y, X);
+                    return FALSE;
+
+                case 0xE:
+                    fprintf(out,
+                            "    V[15] = 0;\n"
+                            "    { uint8_t r = e->quirks ? V[%u] : V[%u]; V[15] = r >> 7; V[%u] = r << 1; }\n",
+                            Y, X, X);
+                    return FALSE;
+            }
+            break;
+
+        case 0xA:
+            fprintf(out, "    *e->I = 0x%03x;\n", NNN);
+            return FALSE;
+
+        case 0xF:
+            switch (NN) {
+                case 0x07:
+                    fprintf(out, "    V[%u] = *e->DT;\n", X);
+                    return FALSE;
+
+                case 0x15:
+                    fprintf(out, "    *e->DT = V[%u];\n", X);
+                    return FALSE;
+
+                case 0x18:
+                    fprintf(out, "    *e->ST = V[%u];\n", X);
+                    return FALSE;
+
+                case 0x1E:
+                    fprintf(out, "    *e->I += V[%u];\n", X);
+                    return FALSE;
+
+                case 0x29:
+                    fprintf(out, "    *e->I = 5 * (V[%u] & 15);\n", X);
+                    return FALSE;
+            }
+            break;
+    }
+
+    /* everything else goes through the interpreter */
+    fprintf(out, "    *e->PC = 0x%03x;\n    e->step(e->state);\n", address);
+
+    Bool ends = FALSE;
+    switch (opcode >> 12) {
+        case 0x0:
+            ends = (opcode == 0x00EE);
+            break;
+
+        case 0x2:
+        case 0xB:
+        case 0xE:
+            ends = TRUE;
+            break;
+
+        case 0xF:
+            ends = (NN == 0x0A || NN == 0x33 || NN == 0x55);
+            break;
+    }
+
+    if (ends)
+        fprintf(out, "    return %u;\n", count);
+
+    return ends;
+}
+
+/* adds the addresses control can reach after the instruction at address,
+ * as far as they are known statically */
+static void push_successors(uint16_t* worklist, int* top, uint16_t opcode, uint16_t address)
+{
+    const uint8_t NN = opcode & 0xff;
+
+    switch (opcode >> 12) {
+        case 0x0:
+            if (opcode != 0x00EE)
+                worklist[(*top)++] = address + 2;
+            return;
+
+        case 0x1:
+            worklist[(*top)++] = opcode & 0x0fff;
+            return;
+
+        case 0x2:
+            worklist[(*top)++] = opcode & 0x0fff;
+            worklist[(*top)++] = address + 2;
+            return;
+
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9:
+        case 0xE:
+            worklist[(*top)++] = address + 2;
+            worklist[(*top)++] = address + 4;
+            return;
+
+        case 0xB:
+            /* computed target, left to the interpreter */
+            return;
+
+        case 0xF:
+            /* FX0A executes itself again until a key is pressed */
+            if (NN == 0x0A)
+                worklist[(*top)++] = address;
+            worklist[(*top)++] = address + 2;
+            return;
+
+        default:
+            worklist[(*top)++] = address + 2;
+            return;
+    }
+}
+
+/* writes the C translation of every block reachable from 0x200 */
+static uint32_t emit_program(FILE* out, const uint8_t* memory, int rom_size)
+{
+    const uint16_t rom_end = PROGRAM_LOAD_ADDRESS + rom_size;
+
+    /* every instruction pushes at most two successors and is visited once */
+    uint16_t worklist[2 * MEMSIZE + 2];
+    uint8_t leader[MEMSIZE] = {0};
+    uint16_t length[MEMSIZE] = {0};
+    uint32_t blocks = 0;
+    int top = 0;
+
+    worklist[top++] = PROGRAM_LOAD_ADDRESS;
+
+    while (top > 0) {
+        uint16_t start = worklist[--top];
+
+        if (start < PROGRAM_LOAD_ADDRESS || start + 1 >= rom_end || leader[start])
+            continue;
+
+        leader[start] = TRUE;
+        fprintf(out, "\nstatic uint32_t b_%03x(struct aot_env* e)\n{\n    uint8_t* V = e->V;\n", start);
+
+        uint16_t pc = start;
+        uint32_t count = 0;
+        Bool ended = FALSE;
+
+        while (!ended && pc + 1 < rom_end && count < MAX_BLOCK_INSTRUCTIONS) {
+            uint16_t opcode = (memory[pc] << 8) | memory[pc + 1];
+
+            count++;
+            ended = emit_instruction(out, opcode, pc, count);
+            if (ended)
+                push_successors(worklist, &top, opcode, pc);
+
+            pc += 2;
+        }
+
+        if (!ended) {
+            fprintf(out, "    *e->PC = 0x%03x;\n    return %u;\n", pc, count);
+            worklist[top++] = pc;
+        }
+
+        fprintf(out, "}\n");
+        length[start] = count;
+        blocks++;
+    }
+
+    fprintf(out, "\nconst struct aot_entry chip8_aot_blocks[] = {\n");
+    for (uint16_t a = 0; a < MEMSIZE; a++) {
+        if (length[a])
+            fprintf(out, "    {0x%03x, %u, b_%03x},\n", a, length[a], a);
+    }
+    fprintf(out, "};\n");
+
+    return blocks;
+}
+
+/* the file name of path without its directories, which can not hold the
+ * star and slash that would end the comment of the generated source */
+static const char* comment_name(const char* path)
+{
+    const char* name = strrchr(path, '/');
+    return name ? name + 1 : path;
+}
+
+/* runs $CC, or cc, on the generated source without a shell, so that nothing
+ * in the paths is taken as shell syntax. $CC is split at blanks, the way make
+ * uses it */
+static int run_compiler(const char* source_path, const char* out_path)
+{
+    const char* flags[] = {"-O2", "-w", "-shared", "-fPIC", "-o", out_path, source_path, NULL};
+    const char* cc = getenv("CC");
+    const char* args[32];
+    char words[1024];
+    int count = 0;
+
+    snprintf(words, sizeof(words), "%s", cc && *cc ? cc : "cc");
+
+    char* cursor;
+    for (char* word = strtok_r(words, " \t", &cursor); word && count < 24; word = strtok_r(NULL, " \t", &cursor))
+        args[count++] = word;
+
+    if (count == 0)
+        args[count++] = "cc";
+
+    memcpy(&args[count], flags, sizeof(flags));
+
+    fprintf(stdout, GREEN_2 "running:");
+    for (int i = 0; args[i]; i++)
+        fprintf(stdout, " %s", args[i]);
+    fprintf(stdout, "\n" RESET);
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return BAD_RETURN_VALUE;
+
+    if (pid == 0) {
+        execvp(args[0], (char* const*)args);
+        fprintf(stdout, RED_2 "Failed: Could not run %s: %s\n" RESET, args[0], strerror(errno));
+        fflush(stdout);
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR)
+            return BAD_RETURN_VALUE;
+    }
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : BAD_RETURN_VALUE;
+}
+
+int aot_compile(const char* rom_path, const char* out_path)
+{
+    /* on the stack like the rest, so that compiles on several threads do not
+     * share it */
+    uint8_t memory[MEMSIZE] = {0};
+
+    FILE* rom = fopen(rom_path, "rb");
+    if (rom == NULL) {
+        debug_log(RED "Failed: Unable to find rom\n" RESET);
+        return BAD_RETURN_VALUE;
+    }
+
+    int rom_size = fread(&memory[PROGRAM_LOAD_ADDRESS], 1, MEMSIZE - PROGRAM_LOAD_ADDRESS, rom);
+    fclose(rom);
+
+    char source_path[4096];
+    snprintf(source_path, sizeof(source_path), "%s.c", out_path);
+
+    FILE* out = fopen(source_path, "w");
+    if (out == NULL) {
+        debug_log(RED "Failed: Unable to create the generated source\n" RESET);
+        return BAD_RETURN_VALUE;
+    }
+
+    fprintf(out,
+            "/* generated by chip8-rb --aot from %s, do not edit */\n"
+            "#include <stdint.h>\n\n"
+            "struct aot_env { %s };\n"
+            "struct aot_entry { uint16_t address; uint16_t length; uint32_t (*fn)(struct aot_env* e); };\n\n"
+            "const uint32_t chip8_aot_abi = %u;\n"
+            "const uint32_t chip8_aot_rom_size = %d;\n"
+            "const uint32_t chip8_aot_rom_hash = 0x%08" PRIx32 ";\n",
+            comment_name(rom_path), EXPAND_STRINGIFY(AOT_ENV_FIELDS), AOT_ABI_VERSION, rom_size,
+            rom_hash(&memory[PROGRAM_LOAD_ADDRESS], rom_size));
+
+    uint32_t blocks = emit_program(out, memory, rom_size);
+    fprintf(out, "const uint32_t chip8_aot_block_count = %u;\n", blocks);
+    fclose(out);
+
+    fprintf(stdout, GREEN_2 "Translated %u blocks\n" RESET, blocks);
+    if (run_compiler(source_path, out_path) == BAD_RETURN_VALUE) {
+        debug_log(RED "Failed: Compiling the generated source\n" RESET);
+        return BAD_RETURN_VALUE;
+    }
+
+    return 0;
+}
+
+struct aot* aot_load(const char* lib_path, const struct chip8_sys* chip8, int rom_size)
+{
+    /* dlopen(NULL) would open the program itself */
+    if (lib_path == NULL) {
+        debug_log(RED "Failed: The aot core needs a library built with --aot\n" RESET);
+        return NULL;
+    }
+
+    /* dlopen() searches the library path for a name without a '/', the
+     * library built with --aot -o is a file relative to the current directory */
+    char local_path[4096];
+    if (strchr(lib_path, '/') == NULL) {
+        snprintf(local_path, sizeof(local_path), "./%s", lib_path);
+        lib_path = local_path;
+    }
+
+    void* handle = dlopen(lib_path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stdout, RED_2 "Failed: %s\n" RESET, dlerror());
+        return NULL;
+    }
+
+    const uint32_t* abi = dlsym(handle, "chip8_aot_abi");
+    const uint32_t* size = dlsym(handle, "chip8_aot_rom_size");
+    const uint32_t* hash = dlsym(handle, "chip8_aot_rom_hash");
+    const uint32_t* count = dlsym(handle, "chip8_aot_block_count");
+    const struct aot_entry* entries = dlsym(handle, "chip8_aot_blocks");
+
+    if (!abi || !size || !hash || !count || !entries || *abi != AOT_ABI_VERSION) {
+        debug_log(RED "Failed: Not a chip8-rb AOT library or built by another version\n" RESET);
+        dlclose(handle);
+        return NULL;
+    }
+
+    if ((int)*size != rom_size || *hash != rom_hash(&chip8->memory[PROGRAM_LOAD_ADDRESS], rom_size)) {
+        debug_log(RED "Failed: AOT library was built from a different ROM\n" RESET);
+        dlclose(handle);
+        return NULL;
+    }
+
+    struct aot* aot = calloc(1, sizeof(*aot));
+    if (aot == NULL) {
+        dlclose(handle);
+        return NULL;
+    }
+
+    aot->handle = handle;
+    for (uint32_t i = 0; i < *count; i++) {
+        const struct aot_entry* entry = &entries[i];
+        uint16_t end = entry->address + 2 * entry->length;
+
+        aot->blocks[entry->address] = entry->fn;
+        aot->block_len[entry->address] = entry->length;
+        aot->block_end[entry->address] = end;
+
+        for (uint16_t a = entry->address; a < end; a++)
+            aot->covered[a / 64] |= 1ull << (a % 64);
+    }
+    aot->loaded = *count;
+
+    return aot;
+}
+
+void aot_destroy(struct aot* aot)
+{
+    if (aot == NULL)
+        return;
+
+    dlclose(aot->handle);
+    free(aot);
+}
+
+/* executes one instruction through the interpreter, called from native code */
+static void aot_step(void* s)
+{
+    fetch(s);
+    decode_execute(s);
+}
+
+uint64_t aot_run(struct state* s, uint64_t budget)
+{
+    struct aot* aot = s->aot;
+    struct chip8_sys* chip8 = s->chip8;
+    struct aot_env env = {
+        .V = chip8->registers,
+        .memory = chip8->memory,
+        .I = &chip8->index,
+        .PC = &chip8->program_counter,
+        .DT = &chip8->delay_timer,
+        .ST = &chip8->sound_timer,
+        .quirks = s->data->quirks,
+        .state = s,
+        .step = aot_step,
+    };
+    uint64_t done = 0;
+
+    while (done < budget) {
+        uint16_t pc = chip8->program_counter;
+        aot_block block = pc < MEMSIZE ? aot->blocks[pc] : NULL;
+
+        /* idle loops are whole blocks, or are not compiled at all */
+        if (block == NULL || aot->block_len[pc] <= IDLE_LOOP_LENGTH) {
+            uint64_t skipped = idle_skip(s, budget - done);
+
+            if (skipped) {
+                done += skipped;
+                continue;
+            }
+        }
+
+        /* blocks can not be left half way, single step the tail of the budget */
+        if (block == NULL || aot->block_len[pc] > budget - done) {
+            aot_step(s);
+            done++;
+            continue;
+        }
+
+        done += block(&env);
+    }
+
+    return done;
+}
+
+void aot_invalidate(struct aot* aot, uint16_t addr, uint16_t len)
+{
+    Bool hit = FALSE;
+
+    for (uint16_t i = 0; i < len && !hit; i++) {
+        uint16_t a = (addr + i) & (MEMSIZE - 1);
+        hit = (aot->covered[a / 64] & (1ull << (a % 64))) != 0;
+    }
+
+    if (!hit)
+        return;
+
+    /* native code can not be regenerated at run time, the overwritten blocks
+     * are run by the interpreter from now on */
+    for (uint16_t a = 0; a < MEMSIZE; a++) {
+        if (aot->blocks[a] && a < addr + len && addr < aot->block_end[a]) {
+            aot->blocks[a] = NULL;
+            aot->invalidated++;
+        }
+    }
+}
+
+void aot_print_stats(const struct aot* aot)
+{
+    fprintf(stdout, GREEN_2 "aot: %u native blocks, %u invalidated by writes\n" RESET, aot->loaded,
+            aot->invalidated);
+}
+
+#else
+
+int aot_compile(const char* rom_path, const char* out_path)
+{
+    (void)rom_path;
+    (void)out_path;
+    debug_log(RED "Failed: AOT compilation needs dlopen, not available on this host\n" RESET);
+    return BAD_RETURN_VALUE;
+}
+
+struct aot* aot_load(const char* lib_path, const struct chip8_sys* chip8, int rom_size)
+{
+    (void)lib_path;
+    (void)chip8;
+    (void)rom_size;
+    return NULL;
+}
+
+void aot_destroy(struct aot* aot)
+{
+    (void)aot;
+}
+
+uint64_t aot_run(struct state* s, uint64_t budget)
+{
+    (void)s;
+    (void)budget;
+    return 0;
+}
+
+void aot_invalidate(struct aot* aot, uint16_t addr, uint16_t len)
+{
+    (void)aot;
+    (void)addr;
+    (void)len;
+}
+
+void aot_print_stats(const struct aot* aot)
+{
+    (void)aot;
+}
+
+#endif
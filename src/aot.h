@@ -0,0 +1,37 @@
+#ifndef REBORN_AOT_H
+#define REBORN_AOT_H
+
+#include "chip.h"
+
+/**
+ * Ahead of time recompilation of a ROM into a shared object.
+ **
+ * aot_compile() follows the control flow of the ROM from 0x200 and writes C
+ * with one function per basic block, then builds it with the host C compiler
+ * ($CC, or cc). aot_load() dlopen()s the result and aot_run() executes the
+ * blocks, falling back to the interpreter for every address that was not
+ * reached statically (BNNN targets, code outside of the ROM) and for blocks
+ * whose bytes have been overwritten since.
+ **/
+
+/* compiles the ROM at rom_path to the shared object out_path, the generated
+ * source is kept as out_path.c. returns BAD_RETURN_VALUE on failure */
+int aot_compile(const char* rom_path, const char* out_path);
+
+/* loads a shared object produced by aot_compile(), verifying that it was
+ * built from the rom_size bytes loaded at 0x200. returns NULL on failure */
+struct aot* aot_load(const char* lib_path, const struct chip8_sys* chip8, int rom_size);
+
+/* closes the shared object and frees the block table */
+void aot_destroy(struct aot* aot);
+
+/* runs exactly budget instructions, returns the number executed */
+uint64_t aot_run(struct state* s, uint64_t budget);
+
+/* stops using the blocks that contain memory[addr] .. memory[addr + len - 1] */
+void aot_invalidate(struct aot* aot, uint16_t addr, uint16_t len);
+
+/* prints the number of native blocks and of invalidated ones to stdout */
+void aot_print_stats(const struct aot* aot);
+
+#endif
@@ -0,0 +1,389 @@
+#define _DEFAULT_SOURCE
+
+#include "batch.h"
+#include "helpers.h"
+#include "libchip8.h"
+#include "watchdog.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+
+enum {
+    MANIFEST_LINE = 4096,
+    /* the ROM and its settings */
+    MANIFEST_FIELDS = 32,
+};
+
+struct job {
+    char* rom_path;
+    struct chip8_launch_data data;
+
+    /* filled in by the worker that ran it, error is an errno value */
+    int error;
+    uint8_t core;
+    uint64_t cycles;
+    uint64_t frames;
+    uint64_t exec_ns;
+    uint64_t hash;
+    uint8_t registers[REGNUM];
+    uint16_t index;
+    uint16_t program_counter;
+    /* where the watchdog found the job halted, when it did */
+    Bool halted;
+    uint16_t halt_pc;
+    uint64_t halt_cycles;
+};
+
+struct worker {
+    /* the jobs this worker has left, first one in the low half and one past
+     * the last in the high half. the owner takes from the front and thieves
+     * from the back, both with a compare and swap of the whole range */
+    _Alignas(64) atomic_uint_fast64_t range;
+    struct batch* batch;
+    unsigned int id;
+    thrd_t thread;
+};
+
+struct batch {
+    struct job* jobs;
+    size_t job_count;
+    struct worker* workers;
+    unsigned int worker_count;
+};
+
+static inline uint64_t make_range(uint32_t first, uint32_t end)
+{
+    return (uint64_t)end << 32 | first;
+}
+
+/* takes the next job off the front of the worker's own range,
+ * returns FALSE when the range is empty */
+static Bool take_job(struct worker* w, uint32_t* job)
+{
+    uint64_t range = atomic_load(&w->range);
+
+    for (;;) {
+        uint32_t first = (uint32_t)range;
+        uint32_t end = range >> 32;
+
+        if (first >= end)
+            return FALSE;
+
+        if (atomic_compare_exchange_weak(&w->range, &range, make_range(first + 1, end))) {
+            *job = first;
+            return TRUE;
+        }
+    }
+}
+
+/* moves the back half of the range of the first other worker that has jobs
+ * left into this one, returns FALSE when there is nothing left to steal.
+ * only called with an empty own range, which no other thread writes to */
+static Bool steal_jobs(struct worker* w)
+{
+    struct batch* b = w->batch;
+
+    for (unsigned int i = 1; i < b->worker_count; i++) {
+        struct worker* victim = &b->workers[(w->id + i) % b->worker_count];
+        uint64_t range = atomic_load(&victim->range);
+
+        for (;;) {
+            uint32_t first = (uint32_t)range;
+            uint32_t end = range >> 32;
+
+            if (first >= end)
+                break;
+
+            uint32_t split = end - (end - first + 1) / 2;
+
+            if (atomic_compare_exchange_weak(&victim->range, &range, make_range(first, split))) {
+                atomic_store(&w->range, make_range(split, end));
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+static void run_job(struct job* job)
+{
+    struct state* s = chip8_create(&job->data);
+
+    if (s == NULL) {
+        job->error = ENOMEM;
+        return;
+    }
+
+    if (chip8_load_rom(s, job->rom_path) == BAD_RETURN_VALUE) {
+        job->error = errno;
+        chip8_destroy(s);
+        return;
+    }
+
+    /* a core that is not available falls back to the switch core,
+     * the core that actually ran is reported */
+    chip8_set_core(s, job->data.core);
+
+    while (s->run == TRUE)
+        chip8_run_frame(s);
+
+    job->core = s->data->core;
+    job->cycles = s->cycles;
+    job->frames = s->frames;
+    job->exec_ns = s->exec_ns;
+    job->hash = hash_display(s->chip8->display);
+    memcpy(job->registers, s->chip8->registers, sizeof(job->registers));
+    job->index = s->chip8->index;
+    job->program_counter = s->chip8->program_counter;
+
+    if (s->watchdog && s->watchdog->halted) {
+        job->halted = TRUE;
+        job->halt_pc = s->watchdog->halt_pc;
+        job->halt_cycles = s->watchdog->halt_cycles;
+    }
+
+    chip8_destroy(s);
+}
+
+static int worker_main(void* arg)
+{
+    struct worker* w = arg;
+    uint32_t job;
+
+    for (;;) {
+        if (take_job(w, &job))
+            run_job(&w->batch->jobs[job]);
+        else if (!steal_jobs(w))
+            return 0;
+    }
+}
+
+/* parses the key=value settings after the ROM path of a manifest line */
+static int parse_job_setting(struct chip8_launch_data* data, const char* setting)
+{
+    const char* value = strchr(setting, '=');
+
+    if (value == NULL || value[1] == '\0')
+        return BAD_RETURN_VALUE;
+
+    size_t key_len = value - setting;
+    value++;
+
+    if (key_len == CP_STRLEN("cycles") && strncmp(setting, "cycles", key_len) == 0)
+        data->cycle_limit = strtoul(value, NULL, 10);
+    else if (key_len == CP_STRLEN("frames") && strncmp(setting, "frames", key_len) == 0)
+        data->frame_limit = strtoul(value, NULL, 10);
+    else if (key_len == CP_STRLEN("freq") && strncmp(setting, "freq", key_len) == 0)
+        data->frequency = strtoul(value, NULL, 10);
+    else if (key_len == CP_STRLEN("seed") && strncmp(setting, "seed", key_len) == 0)
+        data->seed = strtoull(value, NULL, 10);
+    else if (key_len == CP_STRLEN("quirks") && strncmp(setting, "quirks", key_len) == 0)
+        data->quirks = strtoul(value, NULL, 10) != 0;
+    else if (key_len == CP_STRLEN("watchdog") && strncmp(setting, "watchdog", key_len) == 0)
+        data->watchdog = strtoul(value, NULL, 10) != 0;
+    else if (key_len == CP_STRLEN("core") && strncmp(setting, "core", key_len) == 0) {
+        uint8_t core = 0;
+        while (core < CORE_COUNT && strcmp(core_names[core], value) != 0)
+            core++;
+
+        /* the aot core runs the library given with --aot-lib */
+        if (core == CORE_COUNT || (core == CORE_AOT && data->aot_lib == NULL))
+            return BAD_RETURN_VALUE;
+        data->core = core;
+    } else
+        return BAD_RETURN_VALUE;
+
+    return data->frequency < 1 ? BAD_RETURN_VALUE : 0;
+}
+
+/* reads the jobs of a manifest, returns the number of jobs or
+ * BAD_RETURN_VALUE after printing what is wrong with it */
+static long read_manifest(const char* path, const struct chip8_launch_data* defaults, struct job** jobs)
+{
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, RED_2 "chip8-rb: error: Could not open manifest %s: %s\n" RESET, path, strerror(errno));
+        return BAD_RETURN_VALUE;
+    }
+
+    char line[MANIFEST_LINE];
+    size_t count = 0, capacity = 0, line_number = 0;
+    *jobs = NULL;
+
+    while (fgets(line, sizeof(line), fp)) {
+        line_number++;
+
+        /* split the line into whitespace separated fields */
+        char* fields[MANIFEST_FIELDS];
+        int field_count = 0;
+
+        for (char* p = line + strspn(line, " \t\r\n"); *p; p += strspn(p, " \t\r\n")) {
+            /* a comment can be as long as the line */
+            if (field_count == 0 && *p == '#')
+                break;
+
+            if (field_count == MANIFEST_FIELDS) {
+                fprintf(stderr, RED_2 "chip8-rb: error: %s:%zu: More than %d fields\n" RESET, path, line_number,
+                        MANIFEST_FIELDS);
+                goto fail;
+            }
+
+            fields[field_count++] = p;
+            p += strcspn(p, " \t\r\n");
+
+            if (*p)
+                *p++ = '\0';
+        }
+
+        if (field_count == 0)
+            continue;
+
+        struct job job = {.data = *defaults};
+        job.data.headless = TRUE;
+
+        for (int i = 1; i < field_count; i++) {
+            if (parse_job_setting(&job.data, fields[i]) == BAD_RETURN_VALUE) {
+                fprintf(stderr, RED_2 "chip8-rb: error: %s:%zu: Invalid setting '%s'\n" RESET, path, line_number,
+                        fields[i]);
+                goto fail;
+            }
+        }
+
+        if (!job.data.cycle_limit && !job.data.frame_limit) {
+            fprintf(stderr, RED_2 "chip8-rb: error: %s:%zu: Needs cycles= or frames=, or --cycles or --frames\n" RESET,
+                    path, line_number);
+            goto fail;
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            struct job* grown = realloc(*jobs, capacity * sizeof(**jobs));
+
+            if (grown == NULL)
+                goto fail;
+            *jobs = grown;
+        }
+
+        job.rom_path = strdup(fields[0]);
+
+        if (job.rom_path == NULL)
+            goto fail;
+        (*jobs)[count++] = job;
+    }
+
+    fclose(fp);
+    return count;
+
+fail:
+    fclose(fp);
+    for (size_t i = 0; i < count; i++)
+        free((*jobs)[i].rom_path);
+    free(*jobs);
+    return BAD_RETURN_VALUE;
+}
+
+static void print_job(const struct job* job)
+{
+    if (job->error) {
+        fprintf(stdout, "%s\terror\t%s\n", job->rom_path, strerror(job->error));
+        return;
+    }
+
+    char registers[2 * REGNUM + 1];
+    for (int i = 0; i < REGNUM; i++)
+        snprintf(&registers[2 * i], 3, "%02x", job->registers[i]);
+
+    double seconds = job->exec_ns / 1e9;
+
+    fprintf(stdout, "%s\t%s\t%" PRIu64 "\t%" PRIu64 "\t%016" PRIx64 "\t%03x\t%03x\t%s\t%.0f\n", job->rom_path,
+            core_names[job->core], job->cycles, job->frames, job->hash, job->program_counter, job->index, registers,
+            seconds > 0 ? job->cycles / seconds : 0);
+
+    /* stdout stays one line per job */
+    if (job->halted)
+        fprintf(stderr, "%s: halted at PC=0x%03x, after %" PRIu64 " cycles\n", job->rom_path, job->halt_pc,
+                job->halt_cycles);
+}
+
+int batch_run(const char* manifest_path, const struct chip8_launch_data* defaults, unsigned long threads)
+{
+    struct batch b = {0};
+
+    long count = read_manifest(manifest_path, defaults, &b.jobs);
+    if (count == BAD_RETURN_VALUE)
+        return BAD_RETURN_VALUE;
+    b.job_count = count;
+
+    if (threads == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? online : 1;
+#else
+        threads = 1;
+#endif
+    }
+
+    if (threads > b.job_count)
+        threads = b.job_count ? b.job_count : 1;
+
+    b.worker_count = threads;
+    b.workers = aligned_alloc(64, sizeof(*b.workers) * b.worker_count);
+
+    if (b.workers == NULL) {
+        fprintf(stderr, RED_2 "chip8-rb: error: Could not allocate the workers\n" RESET);
+        return BAD_RETURN_VALUE;
+    }
+
+    /* deal the jobs out in contiguous ranges of about the same size */
+    for (unsigned int i = 0; i < b.worker_count; i++) {
+        b.workers[i].batch = &b;
+        b.workers[i].id = i;
+        atomic_init(&b.workers[i].range,
+                    make_range(b.job_count * i / b.worker_count, b.job_count * (i + 1) / b.worker_count));
+    }
+
+    uint64_t start = host_time_ns();
+
+    unsigned int started = 0;
+    for (; started < b.worker_count; started++) {
+        if (thrd_create(&b.workers[started].thread, worker_main, &b.workers[started]) != thrd_success)
+            break;
+    }
+
+    /* whatever could not be started is stolen by the workers that were */
+    if (started == 0)
+        worker_main(&b.workers[0]);
+
+    for (unsigned int i = 0; i < started; i++)
+        thrd_join(b.workers[i].thread, NULL);
+
+    double seconds = (host_time_ns() - start) / 1e9;
+
+    int ret = 0;
+    uint64_t cycles = 0;
+
+    fprintf(stdout, "# rom\tcore\tcycles\tframes\thash\tpc\ti\tv0-vf\tips\n");
+    for (size_t i = 0; i < b.job_count; i++) {
+        print_job(&b.jobs[i]);
+        cycles += b.jobs[i].cycles;
+
+        if (b.jobs[i].error)
+            ret = BAD_RETURN_VALUE;
+
+        free(b.jobs[i].rom_path);
+    }
+
+    fprintf(stderr, GREEN_2 "%zu jobs on %u threads in %.3fs, %.0f instructions per second in total\n" RESET,
+            b.job_count, started ? started : 1, seconds, seconds > 0 ? cycles / seconds : 0);
+
+    free(b.jobs);
+    free(b.workers);
+    return ret;
+}
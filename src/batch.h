@@ -0,0 +1,23 @@
+#ifndef REBORN_BATCH_H
+#define REBORN_BATCH_H
+
+#include "chip.h"
+
+/**
+ * Runs every job of a manifest headless on a pool of worker threads and
+ * prints one tab separated line per job to stdout, in manifest order.
+ **
+ * A manifest has one job per line, a ROM path optionally followed by
+ * key=value settings that override the ones given on the command line for
+ * that job only: cycles=N frames=N freq=N core=NAME quirks=0|1 seed=N
+ * watchdog=0|1. Jobs the watchdog stopped are listed on stderr.
+ * Blank lines and lines starting with '#' are skipped.
+ **
+ * Jobs are dealt out to the workers in contiguous ranges. A worker that
+ * runs out of jobs steals the back half of the range of another one, so a
+ * few slow ROMs do not leave the other threads idle.
+ * Returns BAD_RETURN_VALUE when the manifest cannot be read or a job failed.
+ **/
+int batch_run(const char* manifest_path, const struct chip8_launch_data* defaults, unsigned long threads);
+
+#endif
@@ -0,0 +1,73 @@
+#include "blit.h"
+
+#include <stddef.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#ifndef HAVE_X86_KERNELS
+
+static void expand_row_scalar(uint32_t* pixels, uint64_t row, uint32_t fg, uint32_t bg)
+{
+    for (int w = 0; w < 64; w++)
+        pixels[w] = ((row << w) >> 63) ? fg : bg;
+}
+
+#else
+
+/* 8 pixels per sprite byte, as two vectors of 4. each lane tests its own bit
+ * of the byte and selects fg or bg with the resulting all-ones/all-zero mask */
+static void expand_row_sse2(uint32_t* pixels, uint64_t row, uint32_t fg, uint32_t bg)
+{
+    const __m128i bits_lo = _mm_set_epi32(0x10, 0x20, 0x40, 0x80);
+    const __m128i bits_hi = _mm_set_epi32(0x01, 0x02, 0x04, 0x08);
+    const __m128i fgv = _mm_set1_epi32(fg);
+    const __m128i bgv = _mm_set1_epi32(bg);
+
+    for (int byte = 0; byte < 8; byte++) {
+        __m128i v = _mm_set1_epi32((row >> (56 - 8 * byte)) & 0xff);
+
+        __m128i m = _mm_cmpeq_epi32(_mm_and_si128(v, bits_lo), bits_lo);
+        _mm_storeu_si128((__m128i*)&pixels[8 * byte], _mm_or_si128(_mm_and_si128(m, fgv), _mm_andnot_si128(m, bgv)));
+
+        m = _mm_cmpeq_epi32(_mm_and_si128(v, bits_hi), bits_hi);
+        _mm_storeu_si128((__m128i*)&pixels[8 * byte + 4],
+                         _mm_or_si128(_mm_and_si128(m, fgv), _mm_andnot_si128(m, bgv)));
+    }
+}
+
+/* the same with all 8 pixels of a byte in one vector */
+[[gnu::target("avx2")]] static void expand_row_avx2(uint32_t* pixels, uint64_t row, uint32_t fg, uint32_t bg)
+{
+    const __m256i bits = _mm256_set_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+    const __m256i fgv = _mm256_set1_epi32(fg);
+    const __m256i bgv = _mm256_set1_epi32(bg);
+
+    for (int byte = 0; byte < 8; byte++) {
+        __m256i v = _mm256_set1_epi32((row >> (56 - 8 * byte)) & 0xff);
+        __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(v, bits), bits);
+
+        _mm256_storeu_si256((__m256i*)&pixels[8 * byte], _mm256_blendv_epi8(bgv, fgv, m));
+    }
+}
+
+#endif
+
+void expand_row(uint32_t* pixels, uint64_t row, uint32_t fg, uint32_t bg)
+{
+    static void (*kernel)(uint32_t*, uint64_t, uint32_t, uint32_t) = NULL;
+
+    /* pick the widest kernel the host supports on first use */
+    if (kernel == NULL) {
+#ifdef HAVE_X86_KERNELS
+        __builtin_cpu_init();
+        kernel = __builtin_cpu_supports("avx2") ? expand_row_avx2 : expand_row_sse2;
+#else
+        kernel = expand_row_scalar;
+#endif
+    }
+
+    kernel(pixels, row, fg, bg);
+}
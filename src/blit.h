@@ -0,0 +1,13 @@
+#ifndef REBORN_BLIT_H
+#define REBORN_BLIT_H
+
+#include <stdint.h>
+
+/**
+ * Expands one packed display row (leftmost pixel in the most significant bit)
+ * into 64 RGBA pixels, fg for set bits and bg for clear ones.
+ * Uses AVX2 or SSE2 when the host has them, plain C otherwise.
+ **/
+void expand_row(uint32_t* pixels, uint64_t row, uint32_t fg, uint32_t bg);
+
+#endif
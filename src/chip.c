@@ -1,357 +1,377 @@
+#include "aot.h"
+#include "batch.h"
 #include "chip.h"
-#include "chip_instructions.h"
+#include "debug.h"
+#include "debugger.h"
 #include "graphics.h"
 #include "helpers.h"
+#include "jit.h"
 #include "keyboard.h"
+#include "libchip8.h"
+#include "options.h"
+#include "pacer.h"
+#include "profile.h"
+#include "render.h"
+#include "replay.h"
+#include "rewind.h"
+#include "trace.h"
+#include "watchdog.h"
 
 #include <SDL2/SDL_timer.h>
 #include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
-/* loads the specified rom to memory at adress 0x200 (512)
- * returns the number of character that are read
- */
-static int fetchrom(struct chip8_sys* chip8, const char* name)
+/* hands the display to the render thread once per frame that drew to it, no
+ * matter how many sprites were drawn. with --skip-same a frame whose display
+ * hashes the same as the last one handed over is not presented at all */
+void draw_to_display(struct state* s)
 {
-    FILE* fp = fopen(name, "rb");
-    if (fp == NULL) {
-        debug_log(RED "Failed: Unable to find rom\n" RESET);
-        return BAD_RETURN_VALUE;
-    }
-
-    /* seek to the end of file */
-    if (fseek(fp, 0L, SEEK_END) != 0) {
-        debug_log(RED "Failed: Seek to end of rom file\n" RESET);
-        return BAD_RETURN_VALUE;
-    }
+    uint32_t dirty = s->dirty_rows;
 
-    int file_size = ftell(fp);
+    s->dirty_rows = 0;
+    s->DrawFL = FALSE;
 
-    /* goes back */
-    if (fseek(fp, 0L, SEEK_SET) != 0) {
-        debug_log(RED "Failed: Seek back to previous position\n" RESET);
-        return BAD_RETURN_VALUE;
-    }
+    if (dirty == 0)
+        return;
 
-    /* each chip8 instruction is two bytes long */
-    enum fread_param { inst_byte = 1 };
+    if (s->data->skip_same) {
+        uint64_t hash = hash_display(s->chip8->display);
 
-    if (fread(&chip8->memory[0x200], inst_byte, file_size, fp) != (unsigned long)(file_size / inst_byte)) {
-        debug_log(RED "Failed: Reading ROM to emulator memory\n" RESET);
-        return BAD_RETURN_VALUE;
+        if (s->published && hash == s->published_hash) {
+            s->same_skipped++;
+            return;
+        }
+        s->published_hash = hash;
     }
 
-    fclose(fp);
-    return file_size;
+    /* the stamp of a frame the render thread never showed moves on to this one */
+    s->input_ns = render_publish(s->render, s->chip8->display, s->input_ns);
+    s->published++;
 }
 
-/**
- * fetches the instruction to be executed.
- * also sets the operands (ops) structure.
- * magic constants used here are different mask values to obtain
- * various required bits of the 16-bit opcode on which the instructions operate
- **/
-void fetch(struct state* s)
+/* reports how many presents coalescing the draws of a frame saved */
+static void print_present_stats(const struct state* state, uint64_t presented)
 {
-    s->ops->opcode =
-        (s->chip8->memory[s->chip8->program_counter] << 8) | s->chip8->memory[s->chip8->program_counter + 1];
-
-    uint16_t tmp = (s->ops->opcode << 4) & 0xffff;
-    s->ops->NNN = (tmp >> 4) & 0xffff;
-
-    s->ops->NN = s->chip8->memory[s->chip8->program_counter + 1];
-
-    s->ops->inst = s->ops->opcode >> 8 & 0xff;
-
-    s->ops->inst_nib = (s->ops->inst >> 4) & 0xff;
-
-    s->ops->X = (s->ops->NNN >> 8) & 0xff;
-
-    s->ops->Y = (s->ops->NN >> 4) & 0xff;
-
-    tmp = (s->ops->NN << 4) & 0xff;
-    s->ops->N = (tmp >> 4) & 0xff;
-
-    /* increment the PC */
-    s->chip8->program_counter += 2;
+    fprintf(stdout,
+            GREEN_2 "%" PRIu64 " presents for %" PRIu64 " draw instructions, %" PRIu64 " saved by presenting once per "
+                    "frame, %" PRIu64 " identical frames skipped, %" PRIu64 " dropped by the render thread\n" RESET,
+            presented, state->draw_requests, state->draw_requests - (state->published + state->same_skipped),
+            state->same_skipped, state->published - presented);
 }
 
-void decode_execute(struct state* s)
+/* creates the emulator instance and loads the ROM into it, then creates the
+ * window and the render thread unless running headless */
+static struct state* initialise_emulator(struct sdl_objs* sdl_objs, const struct chip8_launch_data* data)
 {
-    switch (s->ops->inst_nib) {
-        case 0x0:
-            switch (s->ops->NN) {
-                case 0xE0:
-                    instruction_00e0(s);
-                    break;
+    /* verify received arguements aren't NULL pointers */
+    assert(sdl_objs);
+    assert(data);
 
-                case 0xEE:
-                    instruction_00ee(s->chip8);
-                    break;
-            }
-            break;
+    struct state* state = chip8_create(data);
+    if (state == NULL) {
+        fprintf(stderr, RED_2 "Could not allocate the emulator\n" RESET);
+        exit(1);
+    }
 
-        case 0x1:
-            instruction_1nnn(s->chip8, s->ops);
-            break;
+    state->sdl_objs = sdl_objs;
 
-        case 0x2:
-            instruction_2nnn(s->chip8, s->ops);
-            break;
+    if (chip8_load_rom(state, data->rom_path) == BAD_RETURN_VALUE) {
+        fprintf(stdout, RED_2 "Could not load rom %s: %s\n" RESET, data->rom_path, strerror(errno));
+        exit(1);
+    }
+    fprintf(stdout, GREEN_2 "\n\nLoaded Rom - %s\n" RESET, data->rom_path);
 
-        case 0x3:
-            instruction_3xnn(s->chip8, s->ops);
-            break;
+    /* the native code is set up after the ROM has been loaded, so that loading
+     * does not count as overwriting it */
+    if (chip8_set_core(state, data->core) == BAD_RETURN_VALUE) {
+        if (data->core == CORE_JIT)
+            fprintf(stdout, RED_2 "JIT is not available on this host, using the switch core\n" RESET);
+        else
+            fprintf(stdout, RED_2 "Could not load the AOT library, using the switch core\n" RESET);
+    }
 
-        case 0x4:
-            instruction_4xnn(s->chip8, s->ops);
-            break;
+    if (data->load_state) {
+        if (chip8_read_state(state, data->state_path) == BAD_RETURN_VALUE) {
+            fprintf(stdout, RED_2 "Could not load state %s: %s\n" RESET, data->state_path, strerror(errno));
+            exit(1);
+        }
+        fprintf(stdout, GREEN_2 "Loaded State - %s\n" RESET, data->state_path);
 
-        case 0x5:
-            instruction_5xy0(s->chip8, s->ops);
-            break;
+        /* the keypad of the file is not what the keyboard holds, headless
+         * runs have no keyboard and keep it */
+        if (!data->headless)
+            check_and_modify_keystate(SDL_GetKeyboardState(NULL), state);
+    }
 
-        case 0x6:
-            instruction_6xnn(s->chip8, s->ops);
-            break;
+    if (data->profile_path) {
+        state->profile = profile_create();
 
-        case 0x7:
-            instruction_7xnn(s->chip8, s->ops);
-            break;
+        if (state->profile == NULL) {
+            fprintf(stderr, RED_2 "Could not allocate the profile\n" RESET);
+            exit(1);
+        }
+    }
 
-        case 0x8:
-            switch (s->ops->N) {
-                case 0x0:
-                    instruction_8xy0(s->chip8, s->ops);
-                    break;
+    if (data->debugger) {
+        state->debug = debug_create();
 
-                case 0x1:
-                    instruction_8xy1(s->chip8, s->ops);
-                    break;
+        if (state->debug == NULL) {
+            fprintf(stderr, RED_2 "Could not allocate the debugger\n" RESET);
+            exit(1);
+        }
+    }
 
-                case 0x2:
-                    instruction_8xy2(s->chip8, s->ops);
-                    break;
+    if (data->trace_path) {
+        state->trace = trace_open(data->trace_path);
 
-                case 0x3:
-                    instruction_8xy3(s->chip8, s->ops);
-                    break;
+        if (state->trace == NULL) {
+            fprintf(stdout, RED_2 "Could not create trace %s: %s\n" RESET, data->trace_path, strerror(errno));
+            exit(1);
+        }
+        fprintf(stdout, GREEN_2 "Tracing - %s\n" RESET, data->trace_path);
+    }
 
-                case 0x4:
-                    instruction_8xy4(s->chip8, s->ops);
-                    break;
+    if ((data->profile_path || data->trace_path) && data->core != CORE_SWITCH)
+        fprintf(stdout, RED_2 "Profiling and tracing run every core as the switch core\n" RESET);
 
-                case 0x5:
-                    instruction_8xy5(s->chip8, s->ops);
-                    break;
+    /* a recording starts from the machine as it is now, whatever was loaded */
+    if (data->record_path) {
+        state->record = replay_record_open(data->record_path, state);
 
-                case 0x6:
-                    instruction_8xy6(s->chip8, s->ops, s->data);
-                    break;
+        if (state->record == NULL) {
+            fprintf(stdout, RED_2 "Could not create recording %s: %s\n" RESET, data->record_path, strerror(errno));
+            exit(1);
+        }
+        fprintf(stdout, GREEN_2 "Recording - %s\n" RESET, data->record_path);
+    }
 
-                case 0x7:
-                    instruction_8xy7(s->chip8, s->ops);
-                    break;
+    /* sdl objects structure initialisation */
+    if (!data->headless) {
+        *state->sdl_objs = create_window(DISPH * 15, DISPW * 15);
+        fprintf(stdout, GREEN_2 "Created window...\n" RESET);
 
-                case 0xE:
-                    instruction_8xye(s->chip8, s->ops, s->data);
-                    break;
-            }
-            break;
+        state->render = render_start(state->sdl_objs, data->fg, data->bg);
 
-        case 0x9:
-            instruction_9xy0(s->chip8, s->ops);
-            break;
+        if (state->render == NULL) {
+            fprintf(stderr, RED_2 "Could not start the render thread: %s\n" RESET, SDL_GetError());
+            exit(1);
+        }
 
-        case 0xA:
-            instruction_annn(s->chip8, s->ops);
-            break;
+        /* a keyframe a second keeps stepping back cheap. going back in time
+         * cannot be replayed, so there is no rewinding while recording */
+        if (data->rewind_mb && !data->record_path) {
+            state->rewind = rewind_create(data->rewind_mb << 20, FRAME_RATE);
 
-        case 0xB:
-            instruction_bnnn(s->chip8, s->ops);
-            break;
+            if (state->rewind == NULL)
+                fprintf(stdout, RED_2 "Could not allocate the rewind history, rewinding is off\n" RESET);
+        }
+    }
 
-        case 0xC:
-            instruction_cxnn(s->chip8, s->ops);
-            break;
+    return state;
+}
 
-        case 0xD:
-            instruction_dxyn(s);
-            break;
+/* reports how fast the selected core executed, only the time spent running
+ * instructions is counted, not the time spent waiting for the next frame */
+static void print_core_speed(const struct state* state)
+{
+    double seconds = state->exec_ns / 1e9;
+    double ips = seconds > 0 ? state->cycles / seconds : 0;
 
-        case 0xE:
-            switch (s->ops->NN) {
-                case 0x9E:
-                    instruction_ex9e(s);
-                    break;
+    fprintf(stdout, GREEN_2 "%s core: %" PRIu64 " instructions in %.3fs, %.0f instructions per second\n" RESET,
+            core_names[state->data->core], state->cycles, seconds, ips);
 
-                case 0xA1:
-                    instruction_exa1(s);
-                    break;
-            }
-            break;
+    /* skipped instructions count as executed, see idle.h */
+    if (state->idle_cycles)
+        fprintf(stdout, GREEN_2 "%" PRIu64 " of them skipped in idle loops\n" RESET, state->idle_cycles);
 
-        case 0xF:
-            switch (s->ops->NN) {
-                case 0x07:
-                    instruction_fx07(s->chip8, s->ops);
-                    break;
+    if (state->jit)
+        jit_print_stats(state->jit);
 
-                case 0x0A:
-                    instruction_fx0a(s);
-                    break;
+    if (state->aot)
+        aot_print_stats(state->aot);
+}
 
-                case 0x15:
-                    instruction_fx15(s->chip8, s->ops);
-                    break;
+/* runs the emulator without any SDL calls. time is measured in emulated
+ * instructions instead of wall clock */
+static void emulator_headless(struct state* state)
+{
+    while (state->run == TRUE) {
+        if (state->replay)
+            replay_feed(state->replay, state);
 
-                case 0x18:
-                    instruction_fx18(s->chip8, s->ops);
-                    break;
+        chip8_run_frame(state);
 
-                case 0x1E:
-                    instruction_fx1e(s->chip8, s->ops);
-                    break;
+        if (state->debug && debugger_should_prompt(state))
+            debugger_prompt(state);
+    }
 
-                case 0x29:
-                    instruction_fx29(s->chip8, s->ops);
-                    break;
+    fprintf(stdout, GREEN_2 "\nStopped after %" PRIu64 " cycles, %" PRIu64 " frames\n" RESET, state->cycles,
+            state->frames);
 
-                case 0x33:
-                    instruction_fx33(s->chip8, s->ops);
-                    break;
+    if (state->watchdog && state->watchdog->halted)
+        fprintf(stdout, GREEN_2 "Watchdog: halted at PC=0x%03X, after %" PRIu64 " cycles\n" RESET,
+                state->watchdog->halt_pc, state->watchdog->halt_cycles);
+    print_core_speed(state);
+    dump_state(state->chip8);
+}
 
-                case 0x55:
-                    instruction_fx55(s->chip8, s->ops, s->data);
-                    break;
+/* F5 saves the machine to the state file, F9 loads it back */
+static void handle_state_hotkey(struct state* state, SDL_Scancode key)
+{
+    const char* path = state->data->state_path;
+    uint64_t start = host_time_ns();
 
-                case 0x65:
-                    instruction_fx65(s->chip8, s->ops, s->data);
-                    break;
-            }
-            break;
+    if (key == SDL_SCANCODE_F5) {
+        if (chip8_write_state(state, path) == BAD_RETURN_VALUE)
+            fprintf(stdout, RED_2 "Could not save state to %s: %s\n" RESET, path, strerror(errno));
+        else
+            fprintf(stdout, GREEN_2 "Saved state to %s in %" PRIu64 "us\n" RESET, path,
+                    (host_time_ns() - start) / 1000);
+    }
 
-        default:
-            __builtin_unreachable();
+    if (key == SDL_SCANCODE_F9) {
+        if (state->record)
+            fprintf(stdout, RED_2 "Loading states is off while recording\n" RESET);
+        else if (chip8_read_state(state, path) == BAD_RETURN_VALUE)
+            fprintf(stdout, RED_2 "Could not load state from %s: %s\n" RESET, path, strerror(errno));
+        else {
+            fprintf(stdout, GREEN_2 "Loaded state from %s in %" PRIu64 "us\n" RESET, path,
+                    (host_time_ns() - start) / 1000);
+
+            /* the keypad held when the state was saved is not the one held now */
+            check_and_modify_keystate(SDL_GetKeyboardState(NULL), state);
+        }
     }
 }
 
-void draw_to_display(struct state* s)
+/* keeps the host time of the oldest key event waiting to be presented, SDL
+ * stamps events in milliseconds of SDL_GetTicks() */
+static void stamp_input(struct state* state, const SDL_KeyboardEvent* key, uint64_t now, Uint32 ticks)
 {
-    for (uint16_t i = 0; i < DISPW * DISPH; i++) {
-        if (s->chip8->display[i])
-            s->sdl_objs->pixels[i] = s->data->fg;
-        else
-            s->sdl_objs->pixels[i] = s->data->bg;
-    }
+    int32_t age_ms = (int32_t)(ticks - key->timestamp);
+    uint64_t at = now - (uint64_t)(age_ms > 0 ? age_ms : 0) * 1000000;
 
-    SDL_RenderClear(s->sdl_objs->renderer);
-    SDL_UpdateTexture(s->sdl_objs->texture, NULL, s->sdl_objs->pixels, DISPW * sizeof(*s->sdl_objs->pixels));
-    SDL_RenderCopy(s->sdl_objs->renderer, s->sdl_objs->texture, NULL, NULL);
-    SDL_RenderPresent(s->sdl_objs->renderer);
+    /* whatever is in the queue came after it was last drained */
+    if (at < state->drained_ns)
+        at = state->drained_ns;
 
-    s->DrawFL = FALSE;
+    if (state->input_ns == 0 || at < state->input_ns)
+        state->input_ns = at;
 }
 
-struct state initialise_emulator(struct chip8_sys* chip8,
-                                 struct sdl_objs* sdl_objs,
-                                 struct ops* op,
-                                 struct chip8_launch_data* data)
+/* the input stage of a frame, handles every event that queued up since the
+ * last one so that no key waits a frame per event ahead of it */
+static void handle_events(struct state* state)
 {
-    /* verify received arguements aren't NULL pointers */
-    assert(chip8);
-    assert(sdl_objs);
-    assert(op);
-    assert(data);
+    SDL_Event event;
+    uint16_t pressed = 0;
 
-    /* Fill the state structure */
-    struct state state = {0};
+    SDL_PumpEvents();
 
-    state.chip8 = chip8;
-    state.ops = op;
-    state.run = TRUE;
-    state.sdl_objs = sdl_objs;
-    state.DrawFL = FALSE;
-    state.data = data;
+    uint64_t now = host_time_ns();
+    Uint32 ticks = SDL_GetTicks();
 
-    /* chip8 structure initialisation */
-    state.chip8->stacktop = INITIAL_STACK_TOP_LOCATION;
-    state.chip8->program_counter = PROGRAM_LOAD_ADDRESS;
+    while (SDL_PeepEvents(&event, 1, SDL_PEEKEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) == 1) {
+        /* a keypad key let go of in the frame it went down in would never be
+         * seen by the ROM, it and what came after it wait for the next frame */
+        if (event.type == SDL_KEYUP && (keypad_bit(event.key.keysym.scancode) & pressed))
+            break;
 
-    if (fetchrom(chip8, data->rom_path) == BAD_RETURN_VALUE) {
-        exit(1);
-    }
-    fprintf(stdout, GREEN_2 "\n\nLoaded Rom - %s\n" RESET, data->rom_path);
+        SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
 
-    /* sdl objects structure initialisation */
-    *state.sdl_objs = create_window(DISPH * 15, DISPW * 15, data->bg);
-    fprintf(stdout, GREEN_2 "Created window...\n" RESET);
+        switch (event.type) {
+            case SDL_QUIT:
+                state->run = FALSE;
+                break;
 
-    /* Current time seed for bad random
-     * I do not really care if it is truly random */
-    srand(time(NULL));
+            /* only the key that changed is looked up, repeats change nothing */
+            case SDL_KEYUP:
+                modify_keystate(state, event.key.keysym.scancode, FALSE);
+                stamp_input(state, &event.key, now, ticks);
+                break;
 
-    return state;
+            case SDL_KEYDOWN:
+                if (event.key.repeat)
+                    break;
+
+                handle_state_hotkey(state, event.key.keysym.scancode);
+                modify_keystate(state, event.key.keysym.scancode, TRUE);
+                stamp_input(state, &event.key, now, ticks);
+                pressed |= keypad_bit(event.key.keysym.scancode);
+                break;
+        }
+    }
+
+    state->drained_ns = now;
 }
 
 void emulator(struct state* state)
 {
     assert(state);
 
+    if (state->debug)
+        debugger_start(state);
+
+    if (state->data->headless) {
+        emulator_headless(state);
+        return;
+    }
+
+    struct pacer pacer;
+    pacer_start(&pacer);
+
     while (state->run == TRUE) {
-        /* Timing counters */
-        state->current_counter_val = SDL_GetPerformanceCounter();
-        state->delta_time = get_delta_time(state->current_counter_val, state->previous_counter_val);
-        state->delta_accumulation += state->delta_time;
-        state->previous_counter_val = state->current_counter_val;
+        pacer_wait(&pacer);
 
-        fetch(state);
-        decode_execute(state);
+        /* input, instructions, timers and drawing each happen once per frame */
+        handle_events(state);
 
-        SDL_Event event;
-        SDL_PollEvent(&event);
+        /* while Backspace is held every frame steps back instead of forward */
+        if (state->rewind && SDL_GetKeyboardState(NULL)[SDL_SCANCODE_BACKSPACE]) {
+            rewind_step_back(state->rewind, state);
+            check_and_modify_keystate(SDL_GetKeyboardState(NULL), state);
+        } else {
+            if (state->record)
+                replay_record(state->record, state);
 
-        switch (event.type) {
-            case SDL_QUIT:
-                state->run = FALSE;
-                break;
+            chip8_run_frame(state);
 
-            case SDL_KEYUP:
-                check_and_modify_keystate(SDL_GetKeyboardState(NULL), state);
-                break;
+            if (state->debug && debugger_should_prompt(state))
+                debugger_prompt(state);
 
-            case SDL_KEYDOWN:
-                check_and_modify_keystate(SDL_GetKeyboardState(NULL), state);
-                break;
+            if (state->rewind)
+                rewind_push(state->rewind, state);
         }
 
         if (state->DrawFL)
             draw_to_display(state);
+    }
 
-        while (state->delta_accumulation >= TIMER_DEC_RATE) {
-            if (state->chip8->delay_timer > 0)
-                --state->chip8->delay_timer;
-
-            if (state->chip8->sound_timer > 0)
-                --state->chip8->sound_timer;
+    print_core_speed(state);
+    pacer_print_stats(&pacer);
 
-            state->delta_accumulation -= TIMER_DEC_RATE;
-        }
-
-        // implement this quirk - Soon @ Sun, 22 May 2022
-        SDL_Delay(1);
-    }
+    if (state->rewind)
+        rewind_print_stats(state->rewind);
 }
 int main(int argc, char** argv)
 {
     static struct chip8_launch_data data = {.quirks = FALSE,
                                             .yes_rom = FALSE,
                                             .debugger = FALSE,
+                                            .headless = FALSE,
+                                            .core = CORE_SWITCH,
                                             .rom_path = NULL,
                                             .bg = 0x282c34ff,
                                             .fg = 0x61afefff,
-                                            .frequency = 1000};
+                                            .frequency = 1000,
+                                            .rewind_mb = 8};
+
+    struct replay* replay = NULL;
 
     /* argument parsing */
     if (argc < 2) {
@@ -360,49 +380,127 @@ int main(int argc, char** argv)
 
     } else {
         parse_argv(argc, (const char**)argv, &data);
+
+        /* the seed is printed with the settings, so any run can be repeated */
+        if (!data.yes_seed)
+            data.seed = time(NULL);
+
+        /* the hotkeys save next to the ROM unless --load-state names a file */
+        static char state_path[4096];
+        if (!data.state_path && data.rom_path) {
+            snprintf(state_path, sizeof(state_path), "%s.state", data.rom_path);
+            data.state_path = state_path;
+        }
+
+        if (data.aot_rom) {
+            if (data.aot_out == NULL) {
+                fprintf(stdout, RED_2 "chip8-rb: error: --aot needs an output path, -o [FILE]\n" RESET);
+                return 0;
+            }
+            return aot_compile(data.aot_rom, data.aot_out) == BAD_RETURN_VALUE ? 1 : 0;
+        }
+
+        if (data.core == CORE_AOT && data.aot_lib == NULL) {
+            fprintf(stdout, RED_2 "chip8-rb: error: --core aot needs a library built with --aot, given with "
+                                  "--aot-lib [FILE]\n" RESET);
+            return 0;
+        }
+
+        if (data.batch_path)
+            return batch_run(data.batch_path, &data, data.threads) == BAD_RETURN_VALUE ? 1 : 0;
+
+        /* a replay runs with the settings it was recorded with */
+        if (data.replay_path) {
+            replay = replay_open(data.replay_path, &data);
+
+            if (replay == NULL) {
+                fprintf(stdout, RED_2 "chip8-rb: error: Could not read recording %s: %s\n" RESET, data.replay_path,
+                        strerror(errno));
+                return 1;
+            }
+        }
+
         print_chip8_settings(&data);
         if (!data.yes_rom) {
             fprintf(stdout, RED_2 "chip8-rb: error: must specify rom\n" RESET);
             return 0;
         }
+        if (data.headless && !data.cycle_limit && !data.frame_limit) {
+            fprintf(stdout, RED_2 "chip8-rb: error: headless mode needs --cycles or --frames\n" RESET);
+            return 0;
+        }
+        /* a player or a recording can still press a key the machine is waiting for */
+        if (data.watchdog && (!data.headless || replay)) {
+            fprintf(stdout, RED_2 "chip8-rb: error: --watchdog only works with --headless or --batch, and "
+                                  "not with --replay\n" RESET);
+            return 0;
+        }
+        /* headless runs make no SDL calls and have no keyboard */
+        if (!data.headless && data.keymap && load_keymap(data.keymap) == BAD_RETURN_VALUE)
+            return 1;
     }
 
     /* initialise video*/
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
+    if (!data.headless && SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
         fprintf(stderr, RED "Could not init SDL Video: %s\n" RESET, SDL_GetError());
         return BAD_RETURN_VALUE;
     }
 
-    /* Initilaise the structures */
-    static struct chip8_sys chip8 = {.memory = {
-                                         0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
-                                         0x20, 0x60, 0x20, 0x20, 0x70,  // 1
-                                         0xF0, 0x10, 0xF0, 0x80, 0xF0,  // 2
-                                         0xF0, 0x10, 0xF0, 0x10, 0xF0,  // 3
-                                         0x90, 0x90, 0xF0, 0x10, 0x10,  // 4
-                                         0xF0, 0x80, 0xF0, 0x10, 0xF0,  // 5
-                                         0xF0, 0x80, 0xF0, 0x90, 0xF0,  // 6
-                                         0xF0, 0x10, 0x20, 0x40, 0x40,  // 7
-                                         0xF0, 0x90, 0xF0, 0x90, 0xF0,  // 8
-                                         0xF0, 0x90, 0xF0, 0x10, 0xF0,  // 9
-                                         0xF0, 0x90, 0xF0, 0x90, 0x90,  // A
-                                         0xE0, 0x90, 0xE0, 0x90, 0xE0,  // B
-                                         0xF0, 0x80, 0x80, 0x80, 0xF0,  // C
-                                         0xE0, 0x90, 0x90, 0x90, 0xE0,  // D
-                                         0xF0, 0x80, 0xF0, 0x80, 0xF0,  // E
-                                         0xF0, 0x80, 0xF0, 0x80, 0x80   // F
-                                     }};
-    static struct sdl_objs sdl_objs = {0};
-    static struct ops op = {0};
+    struct sdl_objs sdl_objs = {0};
 
     printf(GREEN BOLD ULINE "\n[Chip-8 Reborn]\nEmulator STATUS\n" RESET);
 
-    struct state state = initialise_emulator(&chip8, &sdl_objs, &op, &data);
+    struct state* state = initialise_emulator(&sdl_objs, &data);
+
+    if (replay) {
+        if (!replay_matches_rom(replay, state))
+            fprintf(stdout, RED_2 "%s was not recorded with this ROM, replaying anyway\n" RESET, data.replay_path);
+
+        fprintf(stdout, GREEN_2 "Replaying - %s\n" RESET, data.replay_path);
+        state->replay = replay;
+    }
 
     /* Run the emulator */
-    emulator(&state);
+    emulator(state);
 
     /* On exit */
-    video_cleanup(&sdl_objs);
+    if (replay_close(state->record, state) == BAD_RETURN_VALUE)
+        fprintf(stdout, RED_2 "Could not finish recording %s\n" RESET, data.record_path);
+    replay_close(state->replay, state);
+
+    if (data.exit_state_path) {
+        if (chip8_write_state(state, data.exit_state_path) == BAD_RETURN_VALUE)
+            fprintf(stdout, RED_2 "Could not save state to %s: %s\n" RESET, data.exit_state_path, strerror(errno));
+        else
+            fprintf(stdout, GREEN_2 "Saved state to %s\n" RESET, data.exit_state_path);
+    }
+
+    if (trace_close(state->trace) == BAD_RETURN_VALUE)
+        fprintf(stdout, RED_2 "Could not write all of the trace to %s\n" RESET, data.trace_path);
+
+    if (state->profile) {
+        FILE* fp = fopen(data.profile_path, "w");
+
+        if (fp == NULL) {
+            fprintf(stdout, RED_2 "Could not write profile to %s: %s\n" RESET, data.profile_path, strerror(errno));
+        } else {
+            profile_write_report(state->profile, state->chip8, fp);
+            fclose(fp);
+            fprintf(stdout, GREEN_2 "Wrote profile to %s\n" RESET, data.profile_path);
+        }
+        profile_destroy(state->profile);
+    }
+
+    if (!data.headless) {
+        struct input_latency latency;
+
+        print_present_stats(state, render_stop(state->render, &latency));
+        print_input_latency(&latency);
+        rewind_destroy(state->rewind);
+        video_cleanup(&sdl_objs);
+    }
+
+    debug_destroy(state->debug);
+    chip8_destroy(state);
     return 0;
 }
@@ -1,19 +1,15 @@
 #ifndef REBORN_CHIP_H
 #define REBORN_CHIP_H
 
-#include <SDL2/SDL.h>
+#include <stdint.h>
 
 typedef uint8_t Bool;
 
-#define TIMER_DEC_RATE (double)16666666.666667
-
 // clang-format off
 enum CONSTANTS {
     /* truths */
     FALSE = 0,
     TRUE = 1,
-    DOWN = 0,
-    UP = 1,
 
     /* emulator specific */
     INST_CNT = 35,
@@ -26,6 +22,8 @@ enum CONSTANTS {
     KEYS = 16,
     PROGRAM_LOAD_ADDRESS = 0x200,
     INITIAL_STACK_TOP_LOCATION = -1,
+    FRAME_RATE = 60,
+    MAX_FRAME_LAG = 4,
 
     /* errors */
     BAD_RETURN_VALUE = -1,
@@ -36,9 +34,11 @@ enum CONSTANTS {
 };
 // clang-format on
 
+/* the display is stored one bit per pixel, one 64-bit word per row.
+ * the leftmost pixel of a row is the most significant bit of its word */
 struct chip8_sys {
     uint8_t memory[MEMSIZE];
-    uint8_t display[DISPLAY_SIZE];
+    uint64_t display[DISPH];
     uint16_t stack[STACKSIZE];
     uint8_t registers[REGNUM];
     uint16_t index;
@@ -46,6 +46,9 @@ struct chip8_sys {
     uint8_t delay_timer;
     uint8_t sound_timer;
     uint8_t stacktop;
+    /* state of the CXNN random number generator, kept with the machine so
+     * that a copy of the machine continues with the same random numbers */
+    uint64_t rng;
 };
 
 /* different values related to instructions -
@@ -58,7 +61,11 @@ struct chip8_sys {
  * inst_nib - the first  nibble
  * X        - the second nibble
  * Y        - the third  nibble
- * N        - the fourth nibble */
+ * N        - the fourth nibble
+ * handler  - the instruction the opcode decodes to, see enum instruction
+ *
+ * one ops entry is kept for every address in memory, so that an instruction
+ * is decoded only once and then executed straight from its entry */
 
 struct ops {
     uint16_t opcode;
@@ -69,28 +76,70 @@ struct ops {
     uint8_t X;
     uint8_t Y;
     uint8_t N;
+    uint8_t handler;
 };
 
-struct sdl_objs {
-    SDL_Window* screen;
-    SDL_Renderer* renderer;
-    SDL_Texture* texture;
-    uint32_t* pixels;
-    uint32_t color;
+/* INST_UNDECODED marks an entry that has to be decoded (again) before use,
+ * INST_UNKNOWN is an opcode that does not exist and executes as a no-op */
+// clang-format off
+enum instruction {
+    INST_UNDECODED = 0,
+    INST_00E0, INST_00EE, INST_1NNN, INST_2NNN, INST_3XNN, INST_4XNN, INST_5XY0,
+    INST_6XNN, INST_7XNN, INST_8XY0, INST_8XY1, INST_8XY2, INST_8XY3, INST_8XY4,
+    INST_8XY5, INST_8XY6, INST_8XY7, INST_8XYE, INST_9XY0, INST_ANNN, INST_BNNN,
+    INST_CXNN, INST_DXYN, INST_EX9E, INST_EXA1, INST_FX07, INST_FX0A, INST_FX15,
+    INST_FX18, INST_FX1E, INST_FX29, INST_FX33, INST_FX55, INST_FX65,
+    INST_UNKNOWN
 };
+// clang-format on
+
+/* interpreter cores that can be selected with --core */
+enum cores { CORE_SWITCH = 0, CORE_THREADED = 1, CORE_JIT = 2, CORE_AOT = 3, CORE_COUNT };
+
+static const char* const core_names[CORE_COUNT] = {"switch", "threaded", "jit", "aot"};
 
 struct state {
-    uint8_t keystates[KEYS];
+    /* the keypad, bit N set while key N is held */
+    uint16_t keys;
     struct chip8_sys* chip8;
     struct ops* ops;
+    struct ops* decoded;
+    struct jit* jit;
+    struct aot* aot;
+    struct render* render;
+    struct rewind* rewind;
+    struct replay* record;
+    struct replay* replay;
+    struct profile* profile;
+    struct trace* trace;
+    struct debug* debug;
+    struct watchdog* watchdog;
     struct sdl_objs* sdl_objs;
     struct chip8_launch_data* data;
-    double current_counter_val;
-    double previous_counter_val;
-    double delta_time;
-    double delta_accumulation;
+    int rom_size;
+    unsigned long budget_carry;
+    /* instructions left of a frame the debugger stopped */
+    uint64_t frame_left;
+    uint64_t cycles;
+    uint64_t frames;
+    uint64_t exec_ns;
+    /* instructions counted as executed without running, see idle.h */
+    uint64_t idle_cycles;
     uint8_t run;
     uint8_t DrawFL;
+    /* one bit per display row drawn to since the last present */
+    uint32_t dirty_rows;
+    /* presentation counters, instructions that drew, frames handed to the
+     * render thread and frames not handed over for looking like the last one */
+    uint64_t draw_requests;
+    uint64_t published;
+    uint64_t same_skipped;
+    uint64_t published_hash;
+    /* host time of the oldest key event whose effect was not handed to the
+     * render thread yet, 0 when there is none, and of the last time the event
+     * queue was drained */
+    uint64_t input_ns;
+    uint64_t drained_ns;
 };
 
 struct chip8_launch_data {
@@ -101,8 +150,35 @@ struct chip8_launch_data {
     Bool quirks;
     Bool yes_rom;
     Bool debugger;
+    Bool headless;
+    Bool skip_same;
+    uint8_t core;
+    unsigned long cycle_limit;
+    unsigned long frame_limit;
+    const char* aot_rom;
+    const char* aot_out;
+    const char* aot_lib;
+    const char* batch_path;
+    unsigned long threads;
+    uint64_t seed;
+    Bool yes_seed;
+    const char* state_path;
+    Bool load_state;
+    const char* exit_state_path;
+    unsigned long rewind_mb;
+    const char* record_path;
+    const char* replay_path;
+    const char* profile_path;
+    const char* trace_path;
+    Bool watchdog;
+    const char* keymap;
 };
 
+/* interpreter entry points, defined in core.c */
+void decode_opcode(uint16_t opcode, struct ops* op);
+void fetch(struct state* s);
+void decode_execute(struct state* s);
+
 /* define some popular escape sequences */
 /* visit https://github.com/dylanaraps/pure-bash-bible#text-colors for more info */
 // clang-format off
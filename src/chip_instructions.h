@@ -9,16 +9,35 @@
  *
  */
 
+#include "aot.h"
 #include "chip.h"
 #include "helpers.h"
+#include "jit.h"
 #include <stdint.h>
-#include <time.h>
+#include <string.h>
+
+/* marks the decoded entries that cover memory[addr] .. memory[addr + len - 1]
+ * as stale, and drops the compiled or native blocks that contain the bytes.
+ * the instruction starting at addr - 1 covers memory[addr] too */
+[[gnu::always_inline]] static inline void invalidate_decoded(struct state* s, uint16_t addr, uint16_t len)
+{
+    for (uint16_t a = addr - 1; a != (uint16_t)(addr + len); a++)
+        s->decoded[a & (MEMSIZE - 1)].handler = INST_UNDECODED;
+
+    if (s->jit)
+        jit_invalidate(s->jit, addr, len);
+
+    if (s->aot)
+        aot_invalidate(s->aot, addr, len);
+}
 
 /* clear screen */
 [[gnu::always_inline]] static inline void instruction_00e0(struct state* s)
 {
-    memset(s->chip8->display, 0, DISPLAY_SIZE);
+    memset(s->chip8->display, 0, sizeof(s->chip8->display));
+    s->dirty_rows = UINT32_MAX;
     s->DrawFL = TRUE;
+    s->draw_requests++;
 }
 
 /* return from subroutine */
@@ -187,9 +206,13 @@
 /* Set VX to random number masked with NN */
 [[gnu::always_inline]] static inline void instruction_cxnn(struct chip8_sys* chip8, struct ops* op)
 {
-    // debug
-    uint8_t rnd = rand() % UINT8_MAX;
-    chip8->registers[op->X] = (rnd)&op->NN;
+    /* xorshift64*, the top byte of the product is the best mixed one */
+    chip8->rng ^= chip8->rng >> 12;
+    chip8->rng ^= chip8->rng << 25;
+    chip8->rng ^= chip8->rng >> 27;
+
+    uint8_t rnd = (chip8->rng * 0x2545f4914f6cdd1du) >> 56;
+    chip8->registers[op->X] = rnd & op->NN;
 }
 
 /* draw sprite at (VX,VY) with sprite data from address stored at VI*/
@@ -197,52 +220,38 @@
 {
     uint8_t x = s->chip8->registers[s->ops->X] & (DISPW - 1);
     uint8_t y = s->chip8->registers[s->ops->Y] & (DISPH - 1);
-
-    s->chip8->registers[0xF] = 0;
-
-    for (int h = 0; h < s->ops->N; h++) {
-        /* dont draw on the bottom edge */
-        if (h + y >= DISPH)
-            continue;
-
-        uint16_t pixel = s->chip8->memory[s->chip8->index + h];
-
-        for (int w = 0; w < 8; w++) {
-
-            /* dont draw on the right edge */
-            if (w + x >= DISPW)
-                continue;
-
-            /* if the pixel to be rendered is not zero */
-            if (pixel & (0x80 >> w)) {
-                /* if the pixel already on display is one
-                 * then set VF to 1 to indicate collision
-                 */
-                if (s->chip8->display[(x + w) + ((y + h) * DISPW)])
-                    s->chip8->registers[0xF] = 1;
-
-                /* Simply XOR with pixel since its known that
-                 * pixel on display is already zero
-                 */
-                s->chip8->display[(x + w) + ((y + h) * DISPW)] ^= 1;
-            }
-        }
+    uint64_t collision = 0;
+    int h = 0;
+
+    /* dont draw on the bottom edge */
+    for (; h < s->ops->N && h + y < DISPH; h++) {
+        /* line the 8 sprite pixels up with the row, the pixels that would
+         * go past the right edge are shifted out */
+        uint64_t sprite = ((uint64_t)s->chip8->memory[s->chip8->index + h] << (DISPW - 8)) >> x;
+
+        /* a pixel that is set in both the row and the sprite collides */
+        collision |= s->chip8->display[y + h] & sprite;
+        s->chip8->display[y + h] ^= sprite;
     }
 
+    s->chip8->registers[0xF] = (collision != 0);
+    s->dirty_rows |= (uint32_t)(((1ull << h) - 1) << y);
     s->DrawFL = TRUE;
+    s->draw_requests++;
 }
 
-/* skip next instruction if key in VX is UP*/
+/* skip next instruction if the key in VX is held, only the low nibble of
+ * VX names a key */
 [[gnu::always_inline]] static inline void instruction_ex9e(struct state* s)
 {
-    if (s->keystates[s->chip8->registers[s->ops->X]] == UP)
+    if ((s->keys >> (s->chip8->registers[s->ops->X] & 0xF)) & 1)
         s->chip8->program_counter += 2;
 }
 
-/* skip next instruction if key in VX is DOWN*/
+/* skip next instruction if the key in VX is not held */
 [[gnu::always_inline]] static inline void instruction_exa1(struct state* s)
 {
-    if (s->keystates[s->chip8->registers[s->ops->X]] == DOWN)
+    if (!((s->keys >> (s->chip8->registers[s->ops->X] & 0xF)) & 1))
         s->chip8->program_counter += 2;
 }
 
@@ -252,19 +261,14 @@
     chip8->registers[ops->X] = chip8->delay_timer;
 }
 
-/* wait for a keypress, when pressed store the result in VX */
+/* wait for a keypress, when pressed store the result in VX. the lowest key
+ * held is taken, without any the instruction runs again */
 [[gnu::always_inline]] static inline void instruction_fx0a(struct state* s)
 {
-    s->chip8->program_counter -= 2;
-
-    for (uint8_t i = 0x0; i < 0x10; i++) {
-
-        if (s->keystates[i] == UP) {
-
-            s->chip8->registers[s->ops->X] = i;
-            s->chip8->program_counter += 2;
-        }
-    }
+    if (s->keys)
+        s->chip8->registers[s->ops->X] = __builtin_ctz(s->keys);
+    else
+        s->chip8->program_counter -= 2;
 }
 
 /* set delay timer to VX */
@@ -295,9 +299,10 @@
 /* store VX in BCD format at memory i, i+1, i+2 respectively for H,T,O
  * BCD - Binary Coded Decimal
  * HTO - Hundreds Tens Ones */
-[[gnu::always_inline]] static inline void instruction_fx33(struct chip8_sys* chip8, struct ops* ops)
+[[gnu::always_inline]] static inline void instruction_fx33(struct state* s)
 {
-    uint8_t number = chip8->registers[ops->X];
+    struct chip8_sys* chip8 = s->chip8;
+    uint8_t number = chip8->registers[s->ops->X];
 
     uint8_t o = number % 10;
     number /= 10;
@@ -308,17 +313,22 @@
     chip8->memory[chip8->index] = number;
     chip8->memory[chip8->index + 1] = t;
     chip8->memory[chip8->index + 2] = o;
+
+    invalidate_decoded(s, chip8->index, 3);
 }
 
 /* store the value from range V0 - VX inclusive to address stored in index reg
  */
-[[gnu::always_inline]] static inline void instruction_fx55(struct chip8_sys* chip8, struct ops* ops,
-                                                           struct chip8_launch_data* data)
+[[gnu::always_inline]] static inline void instruction_fx55(struct state* s)
 {
+    struct chip8_sys* chip8 = s->chip8;
+    struct ops* ops = s->ops;
+
     memcpy(&chip8->memory[chip8->index], chip8->registers, ops->X + 1);
+    invalidate_decoded(s, chip8->index, ops->X + 1);
 
     // implementation quirk
-    if (data->quirks)
+    if (s->data->quirks)
         chip8->index += (ops->X + 1);
 }
 
@@ -0,0 +1,859 @@
+#include "libchip8.h"
+#include "aot.h"
+#include "debug.h"
+#include "chip_instructions.h"
+#include "helpers.h"
+#include "idle.h"
+#include "jit.h"
+#include "profile.h"
+#include "trace.h"
+#include "watchdog.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* an emulator instance and everything it owns, in a single allocation.
+ * state comes first so that the handle given out can be freed as is */
+struct instance {
+    struct state state;
+    struct chip8_sys chip8;
+    struct ops decoded[MEMSIZE];
+    struct chip8_launch_data data;
+    struct watchdog watchdog;
+};
+
+/* the built in font, 5 bytes per hex digit, loaded at address 0 */
+static const uint8_t font[16 * 5] = {
+    0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
+    0x20, 0x60, 0x20, 0x20, 0x70,  // 1
+    0xF0, 0x10, 0xF0, 0x80, 0xF0,  // 2
+    0xF0, 0x10, 0xF0, 0x10, 0xF0,  // 3
+    0x90, 0x90, 0xF0, 0x10, 0x10,  // 4
+    0xF0, 0x80, 0xF0, 0x10, 0xF0,  // 5
+    0xF0, 0x80, 0xF0, 0x90, 0xF0,  // 6
+    0xF0, 0x10, 0x20, 0x40, 0x40,  // 7
+    0xF0, 0x90, 0xF0, 0x90, 0xF0,  // 8
+    0xF0, 0x90, 0xF0, 0x10, 0xF0,  // 9
+    0xF0, 0x90, 0xF0, 0x90, 0x90,  // A
+    0xE0, 0x90, 0xE0, 0x90, 0xE0,  // B
+    0xF0, 0x80, 0x80, 0x80, 0xF0,  // C
+    0xE0, 0x90, 0x90, 0x90, 0xE0,  // D
+    0xF0, 0x80, 0xF0, 0x80, 0xF0,  // E
+    0xF0, 0x80, 0xF0, 0x80, 0x80   // F
+};
+
+/* maps an opcode to the instruction that executes it */
+static uint8_t decode_handler(const struct ops* op)
+{
+    switch (op->inst_nib) {
+        case 0x0:
+            switch (op->NN) {
+                case 0xE0:
+                    return INST_00E0;
+
+                case 0xEE:
+                    return INST_00EE;
+            }
+            break;
+
+        case 0x8:
+            switch (op->N) {
+                case 0x0:
+                    return INST_8XY0;
+
+                case 0x1:
+                    return INST_8XY1;
+
+                case 0x2:
+                    return INST_8XY2;
+
+                case 0x3:
+                    return INST_8XY3;
+
+                case 0x4:
+                    return INST_8XY4;
+
+                case 0x5:
+                    return INST_8XY5;
+
+                case 0x6:
+                    return INST_8XY6;
+
+                case 0x7:
+                    return INST_8XY7;
+
+                case 0xE:
+                    return INST_8XYE;
+            }
+            break;
+
+        case 0xE:
+            switch (op->NN) {
+                case 0x9E:
+                    return INST_EX9E;
+
+                case 0xA1:
+                    return INST_EXA1;
+            }
+            break;
+
+        case 0xF:
+            switch (op->NN) {
+                case 0x07:
+                    return INST_FX07;
+
+                case 0x0A:
+                    return INST_FX0A;
+
+                case 0x15:
+                    return INST_FX15;
+
+                case 0x18:
+                    return INST_FX18;
+
+                case 0x1E:
+                    return INST_FX1E;
+
+                case 0x29:
+                    return INST_FX29;
+
+                case 0x33:
+                    return INST_FX33;
+
+                case 0x55:
+                    return INST_FX55;
+
+                case 0x65:
+                    return INST_FX65;
+            }
+            break;
+
+        default: {
+            /* instructions that are identified by their first nibble alone */
+            static const uint8_t by_nibble[0x10] = {
+                [0x1] = INST_1NNN, [0x2] = INST_2NNN, [0x3] = INST_3XNN, [0x4] = INST_4XNN,
+                [0x5] = INST_5XY0, [0x6] = INST_6XNN, [0x7] = INST_7XNN, [0x9] = INST_9XY0,
+                [0xA] = INST_ANNN, [0xB] = INST_BNNN, [0xC] = INST_CXNN, [0xD] = INST_DXYN,
+            };
+            return by_nibble[op->inst_nib];
+        }
+    }
+
+    return INST_UNKNOWN;
+}
+
+/**
+ * splits an opcode into its fields and the instruction it decodes to.
+ * magic constants used here are different mask values to obtain
+ * various required bits of the 16-bit opcode on which the instructions operate
+ **/
+void decode_opcode(uint16_t opcode, struct ops* op)
+{
+    op->opcode = opcode;
+
+    uint16_t tmp = (op->opcode << 4) & 0xffff;
+    op->NNN = (tmp >> 4) & 0xffff;
+
+    op->NN = op->opcode & 0xff;
+
+    op->inst = op->opcode >> 8 & 0xff;
+
+    op->inst_nib = (op->inst >> 4) & 0xff;
+
+    op->X = (op->NNN >> 8) & 0xff;
+
+    op->Y = (op->NN >> 4) & 0xff;
+
+    tmp = (op->NN << 4) & 0xff;
+    op->N = (tmp >> 4) & 0xff;
+
+    op->handler = decode_handler(op);
+}
+
+/* decodes the instruction at address into its ops entry */
+static void predecode(const struct chip8_sys* chip8, uint16_t address, struct ops* op)
+{
+    decode_opcode((chip8->memory[address & (MEMSIZE - 1)] << 8) | chip8->memory[(address + 1) & (MEMSIZE - 1)], op);
+}
+
+/**
+ * fetches the instruction to be executed.
+ * points the operands (ops) of the state at the decoded entry for the PC,
+ * decoding it first when the entry is stale
+ **/
+void fetch(struct state* s)
+{
+    struct ops* op = &s->decoded[s->chip8->program_counter & (MEMSIZE - 1)];
+
+    if (op->handler == INST_UNDECODED)
+        predecode(s->chip8, s->chip8->program_counter, op);
+
+    s->ops = op;
+
+    /* increment the PC */
+    s->chip8->program_counter += 2;
+}
+
+void decode_execute(struct state* s)
+{
+    switch (s->ops->handler) {
+        case INST_00E0:
+            instruction_00e0(s);
+            break;
+
+        case INST_00EE:
+            instruction_00ee(s->chip8);
+            break;
+
+        case INST_1NNN:
+            instruction_1nnn(s->chip8, s->ops);
+            break;
+
+        case INST_2NNN:
+            instruction_2nnn(s->chip8, s->ops);
+            break;
+
+        case INST_3XNN:
+            instruction_3xnn(s->chip8, s->ops);
+            break;
+
+        case INST_4XNN:
+            instruction_4xnn(s->chip8, s->ops);
+            break;
+
+        case INST_5XY0:
+            instruction_5xy0(s->chip8, s->ops);
+            break;
+
+        case INST_6XNN:
+            instruction_6xnn(s->chip8, s->ops);
+            break;
+
+        case INST_7XNN:
+            instruction_7xnn(s->chip8, s->ops);
+            break;
+
+        case INST_8XY0:
+            instruction_8xy0(s->chip8, s->ops);
+            break;
+
+        case INST_8XY1:
+            instruction_8xy1(s->chip8, s->ops);
+            break;
+
+        case INST_8XY2:
+            instruction_8xy2(s->chip8, s->ops);
+            break;
+
+        case INST_8XY3:
+            instruction_8xy3(s->chip8, s->ops);
+            break;
+
+        case INST_8XY4:
+            instruction_8xy4(s->chip8, s->ops);
+            break;
+
+        case INST_8XY5:
+            instruction_8xy5(s->chip8, s->ops);
+            break;
+
+        case INST_8XY6:
+            instruction_8xy6(s->chip8, s->ops, s->data);
+            break;
+
+        case INST_8XY7:
+            instruction_8xy7(s->chip8, s->ops);
+            break;
+
+        case INST_8XYE:
+            instruction_8xye(s->chip8, s->ops, s->data);
+            break;
+
+        case INST_9XY0:
+            instruction_9xy0(s->chip8, s->ops);
+            break;
+
+        case INST_ANNN:
+            instruction_annn(s->chip8, s->ops);
+            break;
+
+        case INST_BNNN:
+            instruction_bnnn(s->chip8, s->ops);
+            break;
+
+        case INST_CXNN:
+            instruction_cxnn(s->chip8, s->ops);
+            break;
+
+        case INST_DXYN:
+            instruction_dxyn(s);
+            break;
+
+        case INST_EX9E:
+            instruction_ex9e(s);
+            break;
+
+        case INST_EXA1:
+            instruction_exa1(s);
+            break;
+
+        case INST_FX07:
+            instruction_fx07(s->chip8, s->ops);
+            break;
+
+        case INST_FX0A:
+            instruction_fx0a(s);
+            break;
+
+        case INST_FX15:
+            instruction_fx15(s->chip8, s->ops);
+            break;
+
+        case INST_FX18:
+            instruction_fx18(s->chip8, s->ops);
+            break;
+
+        case INST_FX1E:
+            instruction_fx1e(s->chip8, s->ops);
+            break;
+
+        case INST_FX29:
+            instruction_fx29(s->chip8, s->ops);
+            break;
+
+        case INST_FX33:
+            instruction_fx33(s);
+            break;
+
+        case INST_FX55:
+            instruction_fx55(s);
+            break;
+
+        case INST_FX65:
+            instruction_fx65(s->chip8, s->ops, s->data);
+            break;
+
+        case INST_UNKNOWN:
+            break;
+
+        default:
+            __builtin_unreachable();
+    }
+}
+
+/* registers an instruction can write to, as they were before it ran. only
+ * VX and VF are written to, except by FX65 which loads V0 to VX, so all of
+ * them are only kept for FX65. comparing the two bytes instead of all the
+ * registers also keeps clear of loading whole words the instruction just
+ * stored single bytes to, which stalls */
+struct trace_before {
+    uint8_t vx;
+    uint8_t vf;
+    uint8_t registers[REGNUM];
+};
+
+[[gnu::always_inline]] static inline void save_trace_before(const struct state* s, struct trace_before* before)
+{
+    before->vx = s->chip8->registers[s->ops->X];
+    before->vf = s->chip8->registers[0xF];
+
+    if (s->ops->handler == INST_FX65)
+        memcpy(before->registers, s->chip8->registers, REGNUM);
+}
+
+/* the record of the instruction that was just executed */
+[[gnu::always_inline]] static inline struct trace_record make_trace_record(const struct state* s,
+                                                                          const struct trace_before* before)
+{
+    const struct chip8_sys* chip8 = s->chip8;
+    uint16_t changed = (chip8->registers[s->ops->X] != before->vx) << s->ops->X |
+                       (chip8->registers[0xF] != before->vf) << 0xF;
+
+    if (s->ops->handler == INST_FX65)
+        for (int i = 0; i <= s->ops->X; i++)
+            changed |= (chip8->registers[i] != before->registers[i]) << i;
+
+    return (struct trace_record){
+        .pc = (s->ops - s->decoded) & (MEMSIZE - 1),
+        .opcode = s->ops->opcode,
+        .index = chip8->index,
+        .changed = changed,
+        .vx = chip8->registers[s->ops->X],
+        .vf = chip8->registers[0xF],
+        .delay_timer = chip8->delay_timer,
+        .sound_timer = chip8->sound_timer,
+        .frame = s->frames,
+    };
+}
+
+/* true when the 1NNN just run can have closed an idle loop, by jumping to
+ * itself or back over the FX07 and the skip before it. the address of the
+ * jump is that of its decoded entry */
+[[gnu::always_inline]] static inline Bool idle_jump(const struct state* s)
+{
+    uint16_t at = s->ops - s->decoded;
+
+    return s->ops->NNN == at || s->ops->NNN == at - 4;
+}
+
+/* the switch core, one fetch and one trip through decode_execute() per
+ * instruction. profile, trace and debug are constants in the callers, so
+ * each gets its own copy of the loop and the one without any of them has no
+ * counting, recording or checking in it at all. returns the number of
+ * instructions executed, fewer than budget when the debugger stopped */
+[[gnu::always_inline]] static inline uint64_t run_switch_loop(struct state* s, uint64_t budget,
+                                                             struct profile* profile, struct trace* trace,
+                                                             struct debug* debug)
+{
+    struct trace_before before = {0};
+
+    for (uint64_t i = 0; i < budget; i++) {
+        if (debug) {
+            if (debug->resuming) {
+                debug->resuming = FALSE;
+            } else if (debug_bit(debug->breakpoints, s->chip8->program_counter)) {
+                debug->stop = DEBUG_BREAKPOINT;
+                return i;
+            }
+        }
+
+        fetch(s);
+
+        if (profile) {
+            profile->pc[(s->chip8->program_counter - 2) & (MEMSIZE - 1)]++;
+            profile->instructions[s->ops->handler]++;
+        }
+
+        if (trace)
+            save_trace_before(s, &before);
+
+        /* only FX33 and FX55 write to memory, the range is taken before I
+         * moves with the quirks */
+        Bool watched = FALSE;
+        if (debug && (s->ops->handler == INST_FX33 || s->ops->handler == INST_FX55))
+            watched = debug_watch_hit(debug, s->chip8->index, s->ops->handler == INST_FX33 ? 3 : s->ops->X + 1);
+
+        decode_execute(s);
+
+        if (trace) {
+            struct trace_record record = make_trace_record(s, &before);
+            trace_append(trace, &record);
+        }
+
+        if (debug) {
+            if (watched) {
+                debug->stop = DEBUG_WATCHPOINT;
+                return i + 1;
+            }
+
+            if (debug->steps_left && --debug->steps_left == 0) {
+                debug->stop = DEBUG_STEP;
+                return i + 1;
+            }
+        }
+
+        /* idle loops only go round through a jump back or a rewinding
+         * FX0A. they are not skipped for the profile, the trace or the
+         * debugger, which all want to see every instruction */
+        if (!profile && !trace && !debug) {
+            if (s->ops->handler == INST_1NNN ? idle_jump(s) : s->ops->handler == INST_FX0A)
+                i += idle_skip(s, budget - i - 1);
+        }
+    }
+
+    return budget;
+}
+
+static uint64_t run_switch(struct state* s, uint64_t budget)
+{
+    return run_switch_loop(s, budget, NULL, NULL, NULL);
+}
+
+/* the switch core counting every instruction into s->profile */
+static uint64_t run_switch_profiled(struct state* s, uint64_t budget)
+{
+    return run_switch_loop(s, budget, s->profile, NULL, NULL);
+}
+
+/* the switch core recording every instruction into s->trace */
+static uint64_t run_switch_traced(struct state* s, uint64_t budget)
+{
+    return run_switch_loop(s, budget, NULL, s->trace, NULL);
+}
+
+/* both, which is not worth a copy of its own */
+static uint64_t run_switch_instrumented(struct state* s, uint64_t budget)
+{
+    return run_switch_loop(s, budget, s->profile, s->trace, NULL);
+}
+
+/* the switch core stopping at breakpoints, watchpoints and after steps,
+ * profiling and tracing along when they are on */
+static uint64_t run_switch_debug(struct state* s, uint64_t budget)
+{
+    return run_switch_loop(s, budget, s->profile, s->trace, s->debug);
+}
+
+/* the threaded core. every handler ends with its own copy of the dispatch to
+ * the next instruction (an indirect goto through a table of label addresses),
+ * which gives the branch predictor one jump per handler to learn from instead
+ * of the single shared jump of the switch in decode_execute()
+ * returns the number of instructions executed */
+static uint64_t run_threaded(struct state* s, uint64_t budget)
+{
+    // clang-format off
+    static void* const dispatch_table[] = {
+        [INST_UNDECODED] = &&undecoded,
+        [INST_00E0] = &&i00e0, [INST_00EE] = &&i00ee, [INST_1NNN] = &&i1nnn, [INST_2NNN] = &&i2nnn,
+        [INST_3XNN] = &&i3xnn, [INST_4XNN] = &&i4xnn, [INST_5XY0] = &&i5xy0, [INST_6XNN] = &&i6xnn,
+        [INST_7XNN] = &&i7xnn, [INST_8XY0] = &&i8xy0, [INST_8XY1] = &&i8xy1, [INST_8XY2] = &&i8xy2,
+        [INST_8XY3] = &&i8xy3, [INST_8XY4] = &&i8xy4, [INST_8XY5] = &&i8xy5, [INST_8XY6] = &&i8xy6,
+        [INST_8XY7] = &&i8xy7, [INST_8XYE] = &&i8xye, [INST_9XY0] = &&i9xy0, [INST_ANNN] = &&iannn,
+        [INST_BNNN] = &&ibnnn, [INST_CXNN] = &&icxnn, [INST_DXYN] = &&idxyn, [INST_EX9E] = &&iex9e,
+        [INST_EXA1] = &&iexa1, [INST_FX07] = &&ifx07, [INST_FX0A] = &&ifx0a, [INST_FX15] = &&ifx15,
+        [INST_FX18] = &&ifx18, [INST_FX1E] = &&ifx1e, [INST_FX29] = &&ifx29, [INST_FX33] = &&ifx33,
+        [INST_FX55] = &&ifx55, [INST_FX65] = &&ifx65, [INST_UNKNOWN] = &&next,
+    };
+    // clang-format on
+
+    struct chip8_sys* chip8 = s->chip8;
+    uint64_t remaining = budget;
+
+/* same as fetch(), but jumps straight to the handler of the instruction */
+#define DISPATCH()                                                                \
+    do {                                                                          \
+        if (remaining == 0)                                                       \
+            return budget;                                                        \
+        remaining--;                                                              \
+        s->ops = &s->decoded[chip8->program_counter & (MEMSIZE - 1)];             \
+        chip8->program_counter += 2;                                              \
+        goto* dispatch_table[s->ops->handler];                                    \
+    } while (0)
+
+    DISPATCH();
+
+undecoded:
+    predecode(chip8, chip8->program_counter - 2, s->ops);
+    goto* dispatch_table[s->ops->handler];
+
+i00e0:
+    instruction_00e0(s);
+    DISPATCH();
+i00ee:
+    instruction_00ee(chip8);
+    DISPATCH();
+i1nnn:
+    instruction_1nnn(chip8, s->ops);
+    if (idle_jump(s))
+        remaining -= idle_skip(s, remaining);
+    DISPATCH();
+i2nnn:
+    instruction_2nnn(chip8, s->ops);
+    DISPATCH();
+i3xnn:
+    instruction_3xnn(chip8, s->ops);
+    DISPATCH();
+i4xnn:
+    instruction_4xnn(chip8, s->ops);
+    DISPATCH();
+i5xy0:
+    instruction_5xy0(chip8, s->ops);
+    DISPATCH();
+i6xnn:
+    instruction_6xnn(chip8, s->ops);
+    DISPATCH();
+i7xnn:
+    instruction_7xnn(chip8, s->ops);
+    DISPATCH();
+i8xy0:
+    instruction_8xy0(chip8, s->ops);
+    DISPATCH();
+i8xy1:
+    instruction_8xy1(chip8, s->ops);
+    DISPATCH();
+i8xy2:
+    instruction_8xy2(chip8, s->ops);
+    DISPATCH();
+i8xy3:
+    instruction_8xy3(chip8, s->ops);
+    DISPATCH();
+i8xy4:
+    instruction_8xy4(chip8, s->ops);
+    DISPATCH();
+i8xy5:
+    instruction_8xy5(chip8, s->ops);
+    DISPATCH();
+i8xy6:
+    instruction_8xy6(chip8, s->ops, s->data);
+    DISPATCH();
+i8xy7:
+    instruction_8xy7(chip8, s->ops);
+    DISPATCH();
+i8xye:
+    instruction_8xye(chip8, s->ops, s->data);
+    DISPATCH();
+i9xy0:
+    instruction_9xy0(chip8, s->ops);
+    DISPATCH();
+iannn:
+    instruction_annn(chip8, s->ops);
+    DISPATCH();
+ibnnn:
+    instruction_bnnn(chip8, s->ops);
+    DISPATCH();
+icxnn:
+    instruction_cxnn(chip8, s->ops);
+    DISPATCH();
+idxyn:
+    instruction_dxyn(s);
+    DISPATCH();
+iex9e:
+    instruction_ex9e(s);
+    DISPATCH();
+iexa1:
+    instruction_exa1(s);
+    DISPATCH();
+ifx07:
+    instruction_fx07(chip8, s->ops);
+    DISPATCH();
+ifx0a:
+    instruction_fx0a(s);
+    remaining -= idle_skip(s, remaining);
+    DISPATCH();
+ifx15:
+    instruction_fx15(chip8, s->ops);
+    DISPATCH();
+ifx18:
+    instruction_fx18(chip8, s->ops);
+    DISPATCH();
+ifx1e:
+    instruction_fx1e(chip8, s->ops);
+    DISPATCH();
+ifx29:
+    instruction_fx29(chip8, s->ops);
+    DISPATCH();
+ifx33:
+    instruction_fx33(s);
+    DISPATCH();
+ifx55:
+    instruction_fx55(s);
+    DISPATCH();
+ifx65:
+    instruction_fx65(chip8, s->ops, s->data);
+    DISPATCH();
+next:
+    DISPATCH();
+
+#undef DISPATCH
+}
+
+/* decrements the delay and sound timers, called at 60hz */
+static void decrement_timers(struct chip8_sys* chip8)
+{
+    if (chip8->delay_timer > 0)
+        --chip8->delay_timer;
+
+    if (chip8->sound_timer > 0)
+        --chip8->sound_timer;
+}
+
+void chip8_run_frame(struct state* state)
+{
+    const struct chip8_launch_data* data = state->data;
+    uint64_t budget;
+
+    /* nothing runs while the debugger has the instance stopped */
+    if (state->debug && state->debug->stop)
+        return;
+
+    /* a frame the debugger stopped part way through is finished first */
+    if (state->frame_left) {
+        budget = state->frame_left;
+        state->frame_left = 0;
+    } else {
+        state->budget_carry += data->frequency;
+        budget = state->budget_carry / FRAME_RATE;
+        state->budget_carry %= FRAME_RATE;
+
+        if (data->cycle_limit && state->cycles + budget > data->cycle_limit)
+            budget = data->cycle_limit - state->cycles;
+    }
+
+    uint64_t start = host_time_ns();
+    uint64_t executed = budget;
+
+    /* the other cores do not go through instructions one by one, so while
+     * debugging, profiling or tracing every core runs as the switch core */
+    if (state->debug && debug_active(state->debug)) {
+        executed = run_switch_debug(state, budget);
+    } else {
+        switch (state->profile || state->trace ? CORE_SWITCH : data->core) {
+            case CORE_THREADED:
+                run_threaded(state, budget);
+                break;
+
+            case CORE_JIT:
+                jit_run(state, budget);
+                break;
+
+            case CORE_AOT:
+                aot_run(state, budget);
+                break;
+
+            default:
+                if (state->profile && state->trace)
+                    run_switch_instrumented(state, budget);
+                else if (state->profile)
+                    run_switch_profiled(state, budget);
+                else if (state->trace)
+                    run_switch_traced(state, budget);
+                else
+                    run_switch(state, budget);
+                break;
+        }
+    }
+
+    state->exec_ns += host_time_ns() - start;
+    state->cycles += executed;
+
+    if (executed < budget) {
+        state->frame_left = budget - executed;
+        return;
+    }
+
+    state->frames++;
+    decrement_timers(state->chip8);
+
+    if (data->cycle_limit && state->cycles >= data->cycle_limit)
+        state->run = FALSE;
+
+    if (data->frame_limit && state->frames >= data->frame_limit)
+        state->run = FALSE;
+
+    if (state->watchdog && state->cycles >= state->watchdog->next)
+        watchdog_sample(state->watchdog, state);
+}
+
+struct state* chip8_create(const struct chip8_launch_data* data)
+{
+    struct instance* inst = calloc(1, sizeof(*inst));
+
+    if (inst == NULL)
+        return NULL;
+
+    /* the instance keeps its own copy of the settings, the native cores are
+     * only set up by chip8_set_core() once the ROM is in memory */
+    inst->data = *data;
+    inst->data.core = CORE_SWITCH;
+
+    memcpy(inst->chip8.memory, font, sizeof(font));
+    inst->chip8.stacktop = INITIAL_STACK_TOP_LOCATION;
+    inst->chip8.program_counter = PROGRAM_LOAD_ADDRESS;
+
+    struct state* s = &inst->state;
+    s->chip8 = &inst->chip8;
+    s->ops = inst->decoded;
+    s->decoded = inst->decoded;
+    s->data = &inst->data;
+    s->run = TRUE;
+    chip8_seed(s, data->seed);
+
+    if (data->watchdog) {
+        s->watchdog = &inst->watchdog;
+        watchdog_reset(s->watchdog, s);
+    }
+
+    return s;
+}
+
+void chip8_seed(struct state* s, uint64_t seed)
+{
+    /* splitmix64, so that nearby seeds give unrelated sequences */
+    uint64_t z = seed + 0x9e3779b97f4a7c15u;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+    z ^= z >> 31;
+
+    /* xorshift never leaves the all zero state */
+    s->chip8->rng = z ? z : 0x9e3779b97f4a7c15u;
+}
+
+void chip8_destroy(struct state* s)
+{
+    if (s == NULL)
+        return;
+
+    jit_destroy(s->jit);
+    aot_destroy(s->aot);
+    free((struct instance*)s);
+}
+
+int chip8_load_rom_mem(struct state* s, const uint8_t* rom, size_t size)
+{
+    if (size > MEMSIZE - PROGRAM_LOAD_ADDRESS) {
+        errno = EFBIG;
+        return BAD_RETURN_VALUE;
+    }
+
+    memcpy(&s->chip8->memory[PROGRAM_LOAD_ADDRESS], rom, size);
+    invalidate_decoded(s, PROGRAM_LOAD_ADDRESS, size);
+    s->rom_size = size;
+
+    return size;
+}
+
+int chip8_load_rom(struct state* s, const char* path)
+{
+    uint8_t rom[MEMSIZE - PROGRAM_LOAD_ADDRESS];
+
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return BAD_RETURN_VALUE;
+
+    /* read one byte more than fits, so that a ROM that is too large is noticed */
+    size_t size = fread(rom, 1, sizeof(rom), fp);
+    Bool too_large = size == sizeof(rom) && fgetc(fp) != EOF;
+    Bool failed = ferror(fp);
+
+    fclose(fp);
+
+    if (failed) {
+        errno = EIO;
+        return BAD_RETURN_VALUE;
+    }
+
+    if (too_large) {
+        errno = EFBIG;
+        return BAD_RETURN_VALUE;
+    }
+
+    return chip8_load_rom_mem(s, rom, size);
+}
+
+int chip8_set_core(struct state* s, uint8_t core)
+{
+    jit_destroy(s->jit);
+    aot_destroy(s->aot);
+    s->jit = NULL;
+    s->aot = NULL;
+    s->data->core = CORE_SWITCH;
+
+    if (core == CORE_JIT) {
+        s->jit = jit_create();
+
+        if (s->jit == NULL)
+            return BAD_RETURN_VALUE;
+    }
+
+    if (core == CORE_AOT) {
+        s->aot = aot_load(s->data->aot_lib, s->chip8, s->rom_size);
+
+        if (s->aot == NULL)
+            return BAD_RETURN_VALUE;
+    }
+
+    s->data->core = core;
+    return 0;
+}
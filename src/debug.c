@@ -0,0 +1,55 @@
+#include "debug.h"
+
+#include <stdlib.h>
+
+struct debug* debug_create(void)
+{
+    return calloc(1, sizeof(struct debug));
+}
+
+void debug_destroy(struct debug* d)
+{
+    free(d);
+}
+
+void debug_set_breakpoint(struct debug* d, uint16_t addr, Bool set)
+{
+    addr &= MEMSIZE - 1;
+
+    if (debug_bit(d->breakpoints, addr) == set)
+        return;
+
+    d->breakpoints[addr / 64] ^= 1ull << (addr % 64);
+
+    if (set)
+        d->breakpoint_count++;
+    else
+        d->breakpoint_count--;
+}
+
+void debug_set_watchpoint(struct debug* d, uint16_t addr, uint16_t len, Bool set)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        uint16_t a = (addr + i) & (MEMSIZE - 1);
+
+        if (set)
+            d->watchpoints[a / 64] |= 1ull << (a % 64);
+        else
+            d->watchpoints[a / 64] &= ~(1ull << (a % 64));
+    }
+
+    /* a page is watched as long as any word of it is */
+    enum { WORDS_PER_PAGE = (1 << DEBUG_PAGE_SHIFT) / 64 };
+    d->watched_pages = 0;
+
+    for (int w = 0; w < MEMSIZE / 64; w++)
+        if (d->watchpoints[w])
+            d->watched_pages |= 1u << (w / WORDS_PER_PAGE);
+}
+
+void debug_resume(struct debug* d, uint64_t steps)
+{
+    d->resuming = d->stop == DEBUG_BREAKPOINT;
+    d->stop = DEBUG_RUNNING;
+    d->steps_left = steps;
+}
@@ -0,0 +1,98 @@
+#ifndef REBORN_DEBUG_H
+#define REBORN_DEBUG_H
+
+#include "chip.h"
+
+/**
+ * Breakpoints, watchpoints and single stepping.
+ **
+ * Breakpoints are a bitmap with one bit per address. Watchpoints on memory
+ * written by FX33 and FX55 are a second bitmap, with a bit per 256 byte page
+ * on top of it so that a write to a page without any is dismissed with one
+ * test. Both are only looked at by a copy of the switch core that
+ * chip8_run_frame() runs while debug_active() is true. Without breakpoints,
+ * watchpoints or steps left the instance runs its normal core at full speed.
+ *
+ * When the debug core stops it sets stop and returns part way through the
+ * frame. The rest of the frame runs on the next chip8_run_frame().
+ **/
+
+enum debug_stop {
+    DEBUG_RUNNING = 0,
+    /* the PC reached a breakpoint, the instruction there has not run */
+    DEBUG_BREAKPOINT,
+    /* an instruction wrote to a watched address, it has run */
+    DEBUG_WATCHPOINT,
+    /* the last of the steps asked for has run */
+    DEBUG_STEP,
+};
+
+struct debug {
+    uint64_t breakpoints[MEMSIZE / 64];
+    uint64_t watchpoints[MEMSIZE / 64];
+    uint16_t watched_pages;
+    unsigned int breakpoint_count;
+
+    /* instructions to run before stopping with DEBUG_STEP, 0 for no limit */
+    uint64_t steps_left;
+
+    /* why execution stopped, cleared with debug_resume() */
+    uint8_t stop;
+    /* the address a DEBUG_WATCHPOINT stop was for */
+    uint16_t watch_addr;
+    /* set by debug_resume(), so that a breakpoint does not stop the
+     * instruction it stopped before again */
+    Bool resuming;
+};
+
+enum { DEBUG_PAGE_SHIFT = 8 };
+
+/* allocates a debugger without breakpoints, returns NULL when out of memory */
+struct debug* debug_create(void);
+
+/* frees the debugger */
+void debug_destroy(struct debug* d);
+
+/* sets or clears the breakpoint at addr */
+void debug_set_breakpoint(struct debug* d, uint16_t addr, Bool set);
+
+/* sets or clears the watchpoints on addr .. addr + len - 1 */
+void debug_set_watchpoint(struct debug* d, uint16_t addr, uint16_t len, Bool set);
+
+/* clears stop and carries on for steps instructions, or until the next
+ * breakpoint or watchpoint when steps is 0 */
+void debug_resume(struct debug* d, uint64_t steps);
+
+[[gnu::always_inline]] static inline Bool debug_bit(const uint64_t* bitmap, uint16_t addr)
+{
+    addr &= MEMSIZE - 1;
+    return (bitmap[addr / 64] >> (addr % 64)) & 1;
+}
+
+/* true while the debug core has to run, for a stop to be noticed */
+[[gnu::always_inline]] static inline Bool debug_active(const struct debug* d)
+{
+    return d->breakpoint_count || d->watched_pages || d->steps_left;
+}
+
+/* true when len bytes written from addr hit a watchpoint, which is then
+ * kept in watch_addr */
+[[gnu::always_inline]] static inline Bool debug_watch_hit(struct debug* d, uint16_t addr, uint16_t len)
+{
+    uint16_t first = addr & (MEMSIZE - 1);
+    uint16_t last = (addr + len - 1) & (MEMSIZE - 1);
+
+    if (!(d->watched_pages & (1u << (first >> DEBUG_PAGE_SHIFT) | 1u << (last >> DEBUG_PAGE_SHIFT))))
+        return FALSE;
+
+    for (uint16_t i = 0; i < len; i++) {
+        if (debug_bit(d->watchpoints, addr + i)) {
+            d->watch_addr = (addr + i) & (MEMSIZE - 1);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+#endif
@@ -0,0 +1,270 @@
+#define _DEFAULT_SOURCE
+
+#include "debugger.h"
+#include "debug.h"
+#include "disasm.h"
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    LINE_SIZE = 256,
+    DEFAULT_LIST_COUNT = 10,
+    DEFAULT_DUMP_SIZE = 64,
+};
+
+static volatile sig_atomic_t interrupted;
+
+static void on_interrupt(int sig)
+{
+    (void)sig;
+    interrupted = 1;
+}
+
+static void print_help(void)
+{
+    fprintf(stdout, "  c                  continue until a breakpoint or watchpoint\n"
+                    "  s [N]              run N instructions, 1 by default\n"
+                    "  b ADDR             set a breakpoint\n"
+                    "  d ADDR             delete a breakpoint\n"
+                    "  w ADDR [LEN]       watch LEN bytes written by FX33 or FX55, 1 by default\n"
+                    "  dw ADDR [LEN]      stop watching\n"
+                    "  i                  list breakpoints and watchpoints\n"
+                    "  r                  show the registers\n"
+                    "  x ADDR [LEN]       dump LEN bytes of memory, 64 by default\n"
+                    "  l [ADDR] [N]       disassemble N instructions from ADDR, the PC by default\n"
+                    "  q                  quit the emulator\n"
+                    "  an empty line repeats the last command, addresses are in hex\n");
+}
+
+static uint16_t opcode_at(const struct chip8_sys* chip8, uint16_t addr)
+{
+    return (chip8->memory[addr & (MEMSIZE - 1)] << 8) | chip8->memory[(addr + 1) & (MEMSIZE - 1)];
+}
+
+/* prints one line of disassembly, the PC marked with '>' and breakpoints with '*' */
+static void print_instruction(const struct state* s, uint16_t addr)
+{
+    char text[32];
+    uint16_t opcode = opcode_at(s->chip8, addr);
+
+    disassemble(opcode, text, sizeof(text));
+    fprintf(stdout, "%c%c 0x%03X  %04X  %s\n", addr == s->chip8->program_counter ? '>' : ' ',
+            debug_bit(s->debug->breakpoints, addr) ? '*' : ' ', addr & (MEMSIZE - 1), opcode, text);
+}
+
+static void print_registers(const struct state* s)
+{
+    const struct chip8_sys* chip8 = s->chip8;
+
+    for (int i = 0; i < REGNUM; i++)
+        fprintf(stdout, "V%X=%02X%s", i, chip8->registers[i], i % 8 == 7 ? "\n" : "  ");
+
+    fprintf(stdout, "PC=%03X  I=%03X  SP=%02X  DT=%02X  ST=%02X  cycles=%" PRIu64 "  frame=%" PRIu64 "\n",
+            chip8->program_counter, chip8->index, chip8->stacktop, chip8->delay_timer, chip8->sound_timer, s->cycles,
+            s->frames);
+}
+
+static void print_memory(const struct chip8_sys* chip8, uint16_t addr, unsigned long len)
+{
+    for (unsigned long i = 0; i < len; i++) {
+        if (i % 16 == 0)
+            fprintf(stdout, "%s0x%03lX:", i ? "\n" : "", (addr + i) & (MEMSIZE - 1));
+
+        fprintf(stdout, " %02X", chip8->memory[(addr + i) & (MEMSIZE - 1)]);
+    }
+
+    fputc('\n', stdout);
+}
+
+/* prints the breakpoints, then the watched addresses as ranges */
+static void print_points(const struct debug* d)
+{
+    fprintf(stdout, "breakpoints:");
+    for (int a = 0; a < MEMSIZE; a++)
+        if (debug_bit(d->breakpoints, a))
+            fprintf(stdout, " 0x%03X", a);
+
+    fprintf(stdout, "\nwatchpoints:");
+    for (int a = 0; a < MEMSIZE; a++) {
+        if (!debug_bit(d->watchpoints, a))
+            continue;
+
+        int end = a;
+        while (end + 1 < MEMSIZE && debug_bit(d->watchpoints, end + 1))
+            end++;
+
+        if (end == a)
+            fprintf(stdout, " 0x%03X", a);
+        else
+            fprintf(stdout, " 0x%03X-0x%03X", a, end);
+        a = end;
+    }
+
+    fputc('\n', stdout);
+}
+
+/* says why the instance stopped and where */
+static void print_stop(const struct state* s)
+{
+    const struct debug* d = s->debug;
+
+    switch (d->stop) {
+        case DEBUG_BREAKPOINT:
+            fprintf(stdout, GREEN_2 "breakpoint at 0x%03X\n" RESET, s->chip8->program_counter & (MEMSIZE - 1));
+            break;
+
+        case DEBUG_WATCHPOINT:
+            fprintf(stdout, GREEN_2 "watchpoint 0x%03X written, now 0x%02X\n" RESET, d->watch_addr,
+                    s->chip8->memory[d->watch_addr]);
+            break;
+
+        default:
+            if (interrupted)
+                fprintf(stdout, GREEN_2 "interrupted\n" RESET);
+            break;
+    }
+
+    print_instruction(s, s->chip8->program_counter);
+}
+
+/* reads the next number of a command, returns FALSE when there is none */
+static Bool next_number(char** cursor, unsigned long* out, int base)
+{
+    char* token = strtok_r(NULL, " \t\n", cursor);
+    char* end;
+
+    if (token == NULL)
+        return FALSE;
+
+    *out = strtoul(token, &end, base);
+    return *end == '\0';
+}
+
+/* runs one command, returns TRUE when it resumed the instance or quit */
+static Bool run_command(struct state* s, char* line)
+{
+    struct debug* d = s->debug;
+    char* cursor;
+    char* command = strtok_r(line, " \t\n", &cursor);
+    unsigned long addr, n;
+
+    if (command == NULL)
+        return FALSE;
+
+    if (strcmp(command, "c") == 0) {
+        debug_resume(d, 0);
+        return TRUE;
+    }
+
+    if (strcmp(command, "s") == 0) {
+        debug_resume(d, next_number(&cursor, &n, BASE_10) && n ? n : 1);
+        return TRUE;
+    }
+
+    if (strcmp(command, "q") == 0) {
+        s->run = FALSE;
+        return TRUE;
+    }
+
+    if (strcmp(command, "b") == 0 || strcmp(command, "d") == 0) {
+        if (!next_number(&cursor, &addr, BASE_16)) {
+            fprintf(stdout, RED_2 "%s needs an address\n" RESET, command);
+            return FALSE;
+        }
+        debug_set_breakpoint(d, addr, command[0] == 'b');
+        return FALSE;
+    }
+
+    if (strcmp(command, "w") == 0 || strcmp(command, "dw") == 0) {
+        if (!next_number(&cursor, &addr, BASE_16)) {
+            fprintf(stdout, RED_2 "%s needs an address\n" RESET, command);
+            return FALSE;
+        }
+        if (!next_number(&cursor, &n, BASE_10) || n == 0 || n > MEMSIZE)
+            n = 1;
+        debug_set_watchpoint(d, addr, n, command[0] == 'w');
+        return FALSE;
+    }
+
+    if (strcmp(command, "i") == 0) {
+        print_points(d);
+        return FALSE;
+    }
+
+    if (strcmp(command, "r") == 0) {
+        print_registers(s);
+        return FALSE;
+    }
+
+    if (strcmp(command, "x") == 0) {
+        if (!next_number(&cursor, &addr, BASE_16)) {
+            fprintf(stdout, RED_2 "x needs an address\n" RESET);
+            return FALSE;
+        }
+        if (!next_number(&cursor, &n, BASE_10) || n == 0 || n > MEMSIZE)
+            n = DEFAULT_DUMP_SIZE;
+        print_memory(s->chip8, addr, n);
+        return FALSE;
+    }
+
+    if (strcmp(command, "l") == 0) {
+        if (!next_number(&cursor, &addr, BASE_16))
+            addr = s->chip8->program_counter;
+        if (!next_number(&cursor, &n, BASE_10) || n == 0)
+            n = DEFAULT_LIST_COUNT;
+        for (unsigned long i = 0; i < n; i++)
+            print_instruction(s, addr + 2 * i);
+        return FALSE;
+    }
+
+    if (strcmp(command, "h") != 0)
+        fprintf(stdout, RED_2 "unknown command '%s'\n" RESET, command);
+
+    print_help();
+    return FALSE;
+}
+
+void debugger_start(struct state* s)
+{
+    signal(SIGINT, on_interrupt);
+
+    fprintf(stdout, GREEN_2 "\nDebugger - h for help, Ctrl-C breaks into it while running\n" RESET);
+    debugger_prompt(s);
+}
+
+Bool debugger_should_prompt(const struct state* s)
+{
+    return s->debug->stop != DEBUG_RUNNING || interrupted;
+}
+
+void debugger_prompt(struct state* s)
+{
+    static char last[LINE_SIZE];
+    char line[LINE_SIZE];
+
+    print_stop(s);
+    interrupted = 0;
+
+    for (;;) {
+        fprintf(stdout, "(chip8-db) ");
+        fflush(stdout);
+
+        /* stdin closing quits, as it would in any other console */
+        if (fgets(line, sizeof(line), stdin) == NULL) {
+            s->run = FALSE;
+            return;
+        }
+
+        if (strspn(line, " \t\n") == strlen(line))
+            memcpy(line, last, sizeof(line));
+        else
+            memcpy(last, line, sizeof(last));
+
+        if (run_command(s, line))
+            return;
+    }
+}
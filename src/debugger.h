@@ -0,0 +1,25 @@
+#ifndef REBORN_DEBUGGER_H
+#define REBORN_DEBUGGER_H
+
+#include "chip.h"
+
+/**
+ * The --debug console.
+ **
+ * Commands are read from stdin whenever the instance stops at a breakpoint,
+ * a watchpoint or after a step, when Ctrl-C is pressed, and once before the
+ * first instruction. 'h' lists them.
+ **/
+
+/* breaks into the debugger on Ctrl-C from now on and prompts for the
+ * first commands */
+void debugger_start(struct state* s);
+
+/* true when the instance stopped or Ctrl-C was pressed since the last prompt */
+Bool debugger_should_prompt(const struct state* s);
+
+/* reads and runs commands until one resumes the instance or quits, which
+ * clears s->run */
+void debugger_prompt(struct state* s);
+
+#endif
@@ -0,0 +1,166 @@
+#include "disasm.h"
+
+#include <stdio.h>
+
+// clang-format off
+const char* const instruction_names[INST_UNKNOWN + 1] = {
+    [INST_UNDECODED] = "----",
+    [INST_00E0] = "00E0", [INST_00EE] = "00EE", [INST_1NNN] = "1NNN", [INST_2NNN] = "2NNN",
+    [INST_3XNN] = "3XNN", [INST_4XNN] = "4XNN", [INST_5XY0] = "5XY0", [INST_6XNN] = "6XNN",
+    [INST_7XNN] = "7XNN", [INST_8XY0] = "8XY0", [INST_8XY1] = "8XY1", [INST_8XY2] = "8XY2",
+    [INST_8XY3] = "8XY3", [INST_8XY4] = "8XY4", [INST_8XY5] = "8XY5", [INST_8XY6] = "8XY6",
+    [INST_8XY7] = "8XY7", [INST_8XYE] = "8XYE", [INST_9XY0] = "9XY0", [INST_ANNN] = "ANNN",
+    [INST_BNNN] = "BNNN", [INST_CXNN] = "CXNN", [INST_DXYN] = "DXYN", [INST_EX9E] = "EX9E",
+    [INST_EXA1] = "EXA1", [INST_FX07] = "FX07", [INST_FX0A] = "FX0A", [INST_FX15] = "FX15",
+    [INST_FX18] = "FX18", [INST_FX1E] = "FX1E", [INST_FX29] = "FX29", [INST_FX33] = "FX33",
+    [INST_FX55] = "FX55", [INST_FX65] = "FX65", [INST_UNKNOWN] = "????",
+};
+// clang-format on
+
+void disassemble(uint16_t opcode, char* out, size_t size)
+{
+    struct ops op;
+    decode_opcode(opcode, &op);
+
+    switch (op.handler) {
+        case INST_00E0:
+            snprintf(out, size, "CLS");
+            break;
+
+        case INST_00EE:
+            snprintf(out, size, "RET");
+            break;
+
+        case INST_1NNN:
+            snprintf(out, size, "JP 0x%03X", op.NNN);
+            break;
+
+        case INST_2NNN:
+            snprintf(out, size, "CALL 0x%03X", op.NNN);
+            break;
+
+        case INST_3XNN:
+            snprintf(out, size, "SE V%X, 0x%02X", op.X, op.NN);
+            break;
+
+        case INST_4XNN:
+            snprintf(out, size, "SNE V%X, 0x%02X", op.X, op.NN);
+            break;
+
+        case INST_5XY0:
+            snprintf(out, size, "SE V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_6XNN:
+            snprintf(out, size, "LD V%X, 0x%02X", op.X, op.NN);
+            break;
+
+        case INST_7XNN:
+            snprintf(out, size, "ADD V%X, 0x%02X", op.X, op.NN);
+            break;
+
+        case INST_8XY0:
+            snprintf(out, size, "LD V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_8XY1:
+            snprintf(out, size, "OR V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_8XY2:
+            snprintf(out, size, "AND V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_8XY3:
+            snprintf(out, size, "XOR V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_8XY4:
+            snprintf(out, size, "ADD V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_8XY5:
+            snprintf(out, size, "SUB V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_8XY6:
+            snprintf(out, size, "SHR V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_8XY7:
+            snprintf(out, size, "SUBN V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_8XYE:
+            snprintf(out, size, "SHL V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_9XY0:
+            snprintf(out, size, "SNE V%X, V%X", op.X, op.Y);
+            break;
+
+        case INST_ANNN:
+            snprintf(out, size, "LD I, 0x%03X", op.NNN);
+            break;
+
+        case INST_BNNN:
+            snprintf(out, size, "JP V0, 0x%03X", op.NNN);
+            break;
+
+        case INST_CXNN:
+            snprintf(out, size, "RND V%X, 0x%02X", op.X, op.NN);
+            break;
+
+        case INST_DXYN:
+            snprintf(out, size, "DRW V%X, V%X, %u", op.X, op.Y, op.N);
+            break;
+
+        case INST_EX9E:
+            snprintf(out, size, "SKP V%X", op.X);
+            break;
+
+        case INST_EXA1:
+            snprintf(out, size, "SKNP V%X", op.X);
+            break;
+
+        case INST_FX07:
+            snprintf(out, size, "LD V%X, DT", op.X);
+            break;
+
+        case INST_FX0A:
+            snprintf(out, size, "LD V%X, K", op.X);
+            break;
+
+        case INST_FX15:
+            snprintf(out, size, "LD DT, V%X", op.X);
+            break;
+
+        case INST_FX18:
+            snprintf(out, size, "LD ST, V%X", op.X);
+            break;
+
+        case INST_FX1E:
+            snprintf(out, size, "ADD I, V%X", op.X);
+            break;
+
+        case INST_FX29:
+            snprintf(out, size, "LD F, V%X", op.X);
+            break;
+
+        case INST_FX33:
+            snprintf(out, size, "LD B, V%X", op.X);
+            break;
+
+        case INST_FX55:
+            snprintf(out, size, "LD [I], V%X", op.X);
+            break;
+
+        case INST_FX65:
+            snprintf(out, size, "LD V%X, [I]", op.X);
+            break;
+
+        default:
+            snprintf(out, size, "DW 0x%04X", op.opcode);
+            break;
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef REBORN_DISASM_H
+#define REBORN_DISASM_H
+
+#include <stddef.h>
+#include "chip.h"
+
+/* the name of every instruction in enum instruction, as its opcode pattern */
+extern const char* const instruction_names[INST_UNKNOWN + 1];
+
+/* writes opcode as assembly to out, in the mnemonics of Cowgod's reference
+ * ("LD V1, 0x05"). opcodes that are not instructions are written as data
+ * ("DW 0x1234") */
+void disassemble(uint16_t opcode, char* out, size_t size);
+
+#endif
@@ -2,7 +2,7 @@
 #include <SDL2/SDL_render.h>
 #include <stdint.h>
 
-struct sdl_objs create_window(const unsigned int height, const unsigned int width, const uint32_t bg)
+struct sdl_objs create_window(const unsigned int height, const unsigned int width)
 {
     struct sdl_objs sdl_objs = {0};
 
@@ -18,20 +18,25 @@ struct sdl_objs create_window(const unsigned int height, const unsigned int widt
         exit(1);
     }
 
+    return sdl_objs;
+}
+
+void create_renderer(struct sdl_objs* sdl_objs, const uint32_t bg)
+{
     /* Create renderer on window */
-    sdl_objs.renderer = SDL_CreateRenderer(sdl_objs.screen, -1, SDL_RENDERER_SOFTWARE);
+    sdl_objs->renderer = SDL_CreateRenderer(sdl_objs->screen, -1, SDL_RENDERER_SOFTWARE);
 
-    if (sdl_objs.renderer == NULL) {
+    if (sdl_objs->renderer == NULL) {
         fprintf(stderr, RED_2 "Could not create render: %s\n" RED_2, SDL_GetError());
         exit(1);
     }
 
-    if (SDL_SetRenderDrawColor(sdl_objs.renderer, 0, 0, 0, 1) < 0) {
+    if (SDL_SetRenderDrawColor(sdl_objs->renderer, 0, 0, 0, 1) < 0) {
         fprintf(stderr, RED_2 "Could not set render color: %s\n" RESET, SDL_GetError());
         exit(1);
     }
 
-    if (SDL_RenderClear(sdl_objs.renderer) < 0) {
+    if (SDL_RenderClear(sdl_objs->renderer) < 0) {
         fprintf(stderr, RED_2 "Could not clear render on screen: %s\n" RESET, SDL_GetError());
         exit(1);
     }
@@ -39,10 +44,10 @@ struct sdl_objs create_window(const unsigned int height, const unsigned int widt
     /* Create a texture in ABGR32 format
      * AGBR32 because We're on left endian machine so when setting pixels
      * we can simply write the hex of the color in RGBA format */
-    sdl_objs.texture =
-        SDL_CreateTexture(sdl_objs.renderer, SDL_PIXELFORMAT_ABGR32, SDL_TEXTUREACCESS_STREAMING, DISPW, DISPH);
+    sdl_objs->texture =
+        SDL_CreateTexture(sdl_objs->renderer, SDL_PIXELFORMAT_ABGR32, SDL_TEXTUREACCESS_STREAMING, DISPW, DISPH);
 
-    if (sdl_objs.texture == NULL) {
+    if (sdl_objs->texture == NULL) {
         fprintf(stderr, RED_2 "Could not create texture: %s\n" RESET, SDL_GetError());
         exit(1);
     }
@@ -54,29 +59,36 @@ struct sdl_objs create_window(const unsigned int height, const unsigned int widt
     for (int i = 0; i < DISPH * DISPW; i++)
         pixels[i] = bg;
 
-    sdl_objs.pixels = pixels;
+    sdl_objs->pixels = pixels;
 
     /* Update the texture and then copy the texture to renderer on window and
      * then present it */
-    if (SDL_UpdateTexture(sdl_objs.texture, NULL, pixels, DISPH * sizeof(*pixels))) {
+    if (SDL_UpdateTexture(sdl_objs->texture, NULL, pixels, DISPW * sizeof(*pixels))) {
         fprintf(stderr, RED_2 "Couldn't update texture: %s\n" RESET, SDL_GetError());
         exit(1);
     }
 
-    if (SDL_RenderCopy(sdl_objs.renderer, sdl_objs.texture, NULL, NULL) < 0) {
+    if (SDL_RenderCopy(sdl_objs->renderer, sdl_objs->texture, NULL, NULL) < 0) {
         fprintf(stderr, RED_2 "Couldn't copy texture to render: %s\n" RESET, SDL_GetError());
         exit(1);
     }
 
-    SDL_RenderPresent(sdl_objs.renderer);
-    return sdl_objs;
+    SDL_RenderPresent(sdl_objs->renderer);
 }
 
-void video_cleanup(struct sdl_objs* sdl_objs)
+void destroy_renderer(struct sdl_objs* sdl_objs)
 {
     SDL_DestroyTexture(sdl_objs->texture);
     SDL_DestroyRenderer(sdl_objs->renderer);
+    free(sdl_objs->pixels);
+
+    sdl_objs->texture = NULL;
+    sdl_objs->renderer = NULL;
+    sdl_objs->pixels = NULL;
+}
+
+void video_cleanup(struct sdl_objs* sdl_objs)
+{
     SDL_DestroyWindow(sdl_objs->screen);
     SDL_Quit();
-    free(sdl_objs->pixels);
 }
@@ -3,10 +3,29 @@
 
 #include "chip.h"
 
+#include <SDL2/SDL.h>
+
+struct sdl_objs {
+    SDL_Window* screen;
+    SDL_Renderer* renderer;
+    SDL_Texture* texture;
+    uint32_t* pixels;
+    uint32_t color;
+    /* the display rows that are currently in the texture, owned by the render thread */
+    uint64_t shown[DISPH];
+};
+
 /**
  * Creates a window of height*width resolution.
- * Also returns a sdl_objs structure defined in chip.h
- * sdl_objs structure contains the following data
+ * Returns a sdl_objs structure with only the
+ * SDL_Window set, the rest is filled in by create_renderer()
+ **/
+struct sdl_objs create_window(const unsigned int height, const unsigned int width);
+
+/**
+ * Creates the renderer, texture and pixels array of a window and presents
+ * the window cleared to bg. Called from the thread that will render to it
+ * sdl_objs structure then contains the following data
  **
  * SDL_Window
  * SDL_Renderer
@@ -14,12 +33,16 @@
  * A Pixels array of 2048 of type uint32_t
  * A uint32_t value representing a RGBA Color value for each pixel
  **/
-struct sdl_objs create_window(const unsigned int height, const unsigned int width, const uint32_t bg);
+void create_renderer(struct sdl_objs* sdl_objs, const uint32_t bg);
+
+/**
+ * Destroyes what create_renderer() created, from the same thread
+ **/
+void destroy_renderer(struct sdl_objs* sdl_objs);
 
 /**
  * Receives a SDL Objects structure
- * Destroyes all 'SDL_x' objects with respective 'SDL_DestroyX' function
- * free()s the pixels array
+ * Destroyes the window and shuts SDL down
  **/
 void video_cleanup(struct sdl_objs* sdl_objs);
 #endif
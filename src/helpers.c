@@ -1,7 +1,6 @@
 #include "helpers.h"
-#include <stdlib.h>
-
-#define CP_STRLEN(str) (sizeof(str) - 1)
+#include <stdio.h>
+#include <time.h>
 
 uint16_t pop(struct chip8_sys* chip8)
 {
@@ -13,163 +12,51 @@ void push(struct chip8_sys* chip8, const uint16_t x)
     chip8->stack[++chip8->stacktop] = x;
 }
 
-double get_delta_time(const double current, const double previous)
+uint64_t host_time_ns(void)
 {
-    return ((current - previous) * 1000000000.0) / SDL_GetPerformanceFrequency();
+    struct timespec ts;
+#ifdef TIME_MONOTONIC
+    timespec_get(&ts, TIME_MONOTONIC);
+#else
+    timespec_get(&ts, TIME_UTC);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
 }
 
-void print_help(void)
+uint64_t hash_display(const uint64_t display[DISPH])
 {
-    puts(BOLD GREEN_2
-         "Dy-Chip8-Reborn\n"
-         "Usage: chip8-rb [OPTIONS]\n\n" RESET BOLD "Options:\n" RESET
-         "  --help             Shows this help page\n"
-         "  --rom [PATH]       Specify path to chip8 ROM file\n"
-         "  --quirks           Enables specific quirks in emulator\n"
-         "  --freq             Specify the frequency at which the emulated cpu runs\n"
-         "  --debug            Enables the debugger in the emulator to debug programs\n"
-         "  --colors [BG] [FG] Specify the background and the foreground color\n" BOLD RED_2
-         "\nAdditional Notes:\n" RESET
-         "  Quirks             There are instruction specific quirks that can be"
-         "enabled by specifying the option.\n"
-         "                     Most ROMs work well without the enable of these quirks.\n\n"
-         "  Freq               The cpu frequency specified should be in megahertz.\n"
-         "                     This option is ignored in this version of this emulator\n\n"
-         "  Colors             The foreground and background colors should both be specified\n"
-         "                     use hexadecimal base, append 'ff' at the end of your color's hex value\n");
-}
+    /* FNV-1a over the rows, a row at a time */
+    uint64_t hash = 0xcbf29ce484222325u;
 
-void bad_arg(void)
-{
-    puts(RED_2 "dy-chip8: invalid usage.\n" RESET "Type 'dy-chip8 -h' for help");
-    exit(EXIT_FAILURE);
+    for (int h = 0; h < DISPH; h++)
+        hash = (hash ^ display[h]) * 0x100000001b3u;
+
+    return hash;
 }
 
-void parse_argv(const int argc, const char** argv, struct chip8_launch_data* data)
+void dump_state(const struct chip8_sys* chip8)
 {
-    char* options[] = {"--help",  "--rom",    "--quirks",
-                       "--freq",  // this will stay until I figure out a proper way to do cpu frequency
-                       "--debug", "--colors", "-h"};
-
-    enum OPTIONS {
-        HELP = 0,
-        ROM = 1,
-        QRK = 2,
-        FRQ = 3,
-        DBG = 4,
-        COL = 5,
-        HELP_2 = 6,
-
-        HELP_L = CP_STRLEN("--help"),
-        HELP_2_L = CP_STRLEN("-h"),
-        ROM_L = CP_STRLEN("--rom"),
-        QRK_L = CP_STRLEN("--quirks"),
-        FRQ_L = CP_STRLEN("--freq"),
-        DBG_L = CP_STRLEN("--debug"),
-        COL_L = CP_STRLEN("--colors")
-    };
-
-    size_t index = 1;
-    while (index < (size_t)argc) {
-        if (strncmp(options[HELP], argv[index], HELP_L) == 0 || strncmp(options[HELP_2], argv[index], HELP_2_L) == 0) {
-            print_help();
-            exit(EXIT_SUCCESS);
-        }
-
-        if (strncmp(options[ROM], argv[index], ROM_L) == 0) {
-            index++;
-
-            if ((index >= (size_t)argc))
-                bad_arg();
-            if (argv[index][0] == '-')
-                bad_arg();
-
-            data->rom_path = argv[index];
-            data->yes_rom = TRUE;
-            index++;
-
-            continue;
-        }
-
-        if (strncmp(options[QRK], argv[index], QRK_L) == 0) {
-            data->quirks = TRUE;
-            index++;
-
-            continue;
-        }
-
-        if (strncmp(options[DBG], argv[index], DBG_L) == 0) {
-            data->debugger = TRUE;
-            index++;
+    printf(BOLD ULINE GREEN "\nMachine State\n\n" RESET);
 
-            continue;
-        }
+    for (uint8_t i = 0; i < REGNUM; i++)
+        printf(BLUE "V%X" RESET " = %02x%s", i, chip8->registers[i], (i % 8 == 7) ? "\n" : "  ");
 
-        if (strncmp(options[FRQ], argv[index], FRQ_L) == 0) {
-            index++;
+    printf(BLUE "I " RESET " = %03x  " BLUE "PC" RESET " = %03x  " BLUE "DT" RESET " = %02x  " BLUE "ST" RESET " = %02x\n",
+           chip8->index, chip8->program_counter, chip8->delay_timer, chip8->sound_timer);
 
-            if (index >= (size_t)argc)
-                bad_arg();
-            if (argv[index][0] == '-')
-                bad_arg();
+    printf(BLUE "Stack" RESET " -");
+    for (int i = 0; i <= (int8_t)chip8->stacktop; i++)
+        printf(" %03x", chip8->stack[i]);
+    printf("\n\n");
 
-            data->frequency = strtoul(argv[index], NULL, 10);
-            if (data->frequency < 1) {
-                fprintf(stdout, RED_2 "chip8-rb: error: Invalid argument for frequency\n" RESET);
-                bad_arg();
-            }
-            index++;
-
-            continue;
-        }
-
-        if (strncmp(options[COL], argv[index], COL_L) == 0) {
-            index++;
-
-            if (index >= (size_t)argc)
-                bad_arg();
-            if (argv[index][0] == '-')
-                bad_arg();
-
-            data->bg = strtol(argv[index], NULL, 16);
-
-            index++;
-
-            if (index >= (size_t)argc)
-                bad_arg();
-            if (argv[index][0] == '-')
-                bad_arg();
-
-            data->fg = strtol(argv[index], NULL, 16);
-
-            index++;
-
-            continue;
-        }
-
-        /* if nothing matches then bad argument*/
-        bad_arg();
+    /* framebuffer, one character per pixel */
+    for (int h = 0; h < DISPH; h++) {
+        for (int w = 0; w < DISPW; w++)
+            putchar((chip8->display[h] << w) >> (DISPW - 1) ? '#' : '.');
+        putchar('\n');
     }
 }
 
-void print_chip8_settings(const struct chip8_launch_data* data)
-{
-    // clang-format off
-    printf(BOLD ULINE GREEN"\n[Chip-8 Reborn]\nEmulator Settings\n\n" RESET
-        BLUE "%16s " RESET "- %15d\n"
-        BLUE "%16s " RESET "- %s\n"
-        BLUE "%16s " RESET "- %15x\n"
-        BLUE "%16s " RESET "- %15x\n"
-        BLUE "%16s " RESET "- %15lu Mhz\n"
-        BLUE "%16s " RESET "- %15d\n"
-        BLUE "%16s " RESET "- %15d\n"
-        GREEN_2 BOLD "\nLegend - 0 for Disabled, 1 for Enabled\n" RESET,
-        "Rom Available", data->yes_rom, "Rom Path", data->rom_path, "Fg",
-           data->fg, "Bg", data->bg, "Frequency", data->frequency,
-           "Qurks Enabled", data->quirks, "Debugger Enabled", data->debugger);
-    // clang-format on
-}
-
 void debug_log(const char* string)
 {
     fprintf(stdout, "chip8: %s", string);
@@ -3,6 +3,9 @@
 #include <stddef.h>
 #include "chip.h"
 
+/* length of a string literal, without the terminator */
+#define CP_STRLEN(str) (sizeof(str) - 1)
+
 /* takes in a pointer to chip8 instance, returns the topmost value from stack,
  * decrements the  stacktop */
 uint16_t pop(struct chip8_sys* chip8);
@@ -11,20 +14,15 @@ uint16_t pop(struct chip8_sys* chip8);
  * first increments the stacktop and then stores the value at STACK[stacktop] */
 void push(struct chip8_sys* chip8, const uint16_t x);
 
-/* takes in the current and previous value of the SDL High Performance Counter
- * Calculates the delta (current - previous)
- * converts to nanoseconds and then returns the value */
-double get_delta_time(const double current, const double previous);
-
-/* outputs bad usage error to terminal*/
-void bad_arg(void);
+/* returns a monotonic host timestamp in nanoseconds, does not depend on SDL */
+uint64_t host_time_ns(void);
 
-/* parses the options passed to the emulator and sets up the runtime structure
- */
-void parse_argv(const int argc, const char** argv, struct chip8_launch_data* data);
+/* returns a 64 bit hash of the packed display rows */
+uint64_t hash_display(const uint64_t display[DISPH]);
 
-/* prints out the chip8_launch_data structure to stdout */
-void print_chip8_settings(const struct chip8_launch_data* data);
+/* prints the registers, stack, timers and the framebuffer of a chip8 instance
+ * to stdout, used at the end of headless runs */
+void dump_state(const struct chip8_sys* chip8);
 
 /* logs to terminal when DEBUG is defined */
 void debug_log(const char* string);
@@ -0,0 +1,81 @@
+#ifndef REBORN_IDLE_H
+#define REBORN_IDLE_H
+
+#include "chip.h"
+
+/**
+ * Idle loop detection.
+ **
+ * ROMs wait in one of three loops, which change nothing until a frame ends
+ * and the timers tick or the keypad changes between frames:
+ *
+ *   1NNN to itself                  halted for good
+ *   FX0A with no key down           waiting for a key, the PC is rewound
+ *   FX07, 3XNN or 4XNN, 1NNN back   polling the delay timer
+ *
+ * Once such a loop has gone round once every further time round leaves the
+ * machine as it was, so the cores count those as executed without running
+ * them. Only whole times round are skipped, the instructions of the frame
+ * left over run as usual, and cycles, the PC and the registers end the frame
+ * the same as if every instruction had run.
+ **/
+
+/* the most instructions an idle loop has */
+enum { IDLE_LOOP_LENGTH = 3 };
+
+[[gnu::always_inline]] static inline uint16_t idle_opcode(const struct chip8_sys* chip8, uint16_t addr)
+{
+    return (chip8->memory[addr] << 8) | chip8->memory[addr + 1];
+}
+
+/* the number of the remaining instructions of the frame that can be skipped
+ * with the machine waiting at the PC, 0 when it is not in an idle loop */
+[[gnu::always_inline]] static inline uint64_t idle_loop(const struct state* s, uint64_t remaining)
+{
+    const struct chip8_sys* chip8 = s->chip8;
+    uint16_t pc = chip8->program_counter;
+
+    if (pc > MEMSIZE - 6)
+        return 0;
+
+    uint16_t opcode = idle_opcode(chip8, pc);
+
+    if (opcode == (0x1000 | pc))
+        return remaining;
+
+    if ((opcode & 0xF0FF) == 0xF00A)
+        return s->keys ? 0 : remaining;
+
+    if ((opcode & 0xF0FF) != 0xF007 || idle_opcode(chip8, pc + 4) != (0x1000 | pc))
+        return 0;
+
+    /* the skip reads the VX the FX07 loaded, which has to be the timer
+     * already for a time round to change nothing */
+    uint8_t x = (opcode >> 8) & 0xF;
+    uint16_t skip = idle_opcode(chip8, pc + 2);
+    uint16_t kind = skip & 0xF000;
+    uint8_t dt = chip8->delay_timer;
+
+    if ((kind != 0x3000 && kind != 0x4000) || ((skip >> 8) & 0xF) != x || chip8->registers[x] != dt)
+        return 0;
+
+    /* 3XNN leaves the loop once the timer is NN, 4XNN once it is not */
+    if ((dt == (skip & 0xFF)) == (kind == 0x3000))
+        return 0;
+
+    return remaining - remaining % 3;
+}
+
+/* idle_loop(), counting the instructions skipped into s->idle_cycles */
+[[gnu::always_inline]] static inline uint64_t idle_skip(struct state* s, uint64_t remaining)
+{
+    uint64_t skipped = idle_loop(s, remaining);
+
+    /* no store on the jumps that are not idle */
+    if (skipped)
+        s->idle_cycles += skipped;
+
+    return skipped;
+}
+
+#endif
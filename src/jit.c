@@ -0,0 +1,503 @@
+/* MAP_ANONYMOUS is not part of strict ISO C */
+#define _DEFAULT_SOURCE
+
+#include "jit.h"
+#include "helpers.h"
+#include "idle.h"
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__unix__)
+
+#include <sys/mman.h>
+
+/* a compiled block, returns the number of instructions it executed */
+typedef uint32_t (*jit_block)(struct state* s);
+
+// clang-format off
+enum JIT_CONSTANTS {
+    CODE_BUFFER_SIZE = 1 << 20,
+    MAX_BLOCK_INSTRUCTIONS = 64,
+    /* the longest sequence emitted for a single instruction, with some slack */
+    MAX_INSTRUCTION_BYTES = 48,
+    MAX_BLOCK_BYTES = 32 + MAX_BLOCK_INSTRUCTIONS * MAX_INSTRUCTION_BYTES,
+
+    /* host registers, as encoded in the reg field of a ModRM byte */
+    AL = 0,
+    CL = 1,
+    DL = 2,
+};
+// clang-format on
+
+struct jit {
+    uint8_t* code;
+    size_t used;
+    jit_block blocks[MEMSIZE];
+    uint8_t block_len[MEMSIZE];
+    /* one bit per byte of chip8 memory that is part of a compiled block */
+    uint64_t covered[MEMSIZE / 64];
+    uint64_t compiled;
+    uint64_t flushes;
+};
+
+/* displacements of the chip8 registers relative to the chip8_sys pointer,
+ * which the compiled code keeps in rbx */
+#define OFF_V(x) (int32_t)(offsetof(struct chip8_sys, registers) + (x))
+#define OFF_I (int32_t) offsetof(struct chip8_sys, index)
+#define OFF_PC (int32_t) offsetof(struct chip8_sys, program_counter)
+#define OFF_DT (int32_t) offsetof(struct chip8_sys, delay_timer)
+#define OFF_ST (int32_t) offsetof(struct chip8_sys, sound_timer)
+
+/* ModRM byte for [rbx + disp32] with the given register in the reg field */
+#define RBX_DISP32(reg) (uint8_t)(0x80 | ((reg) << 3) | 0x3)
+
+struct emitter {
+    uint8_t* p;
+};
+
+static void emit8(struct emitter* e, uint8_t b)
+{
+    *e->p++ = b;
+}
+
+static void emit16(struct emitter* e, uint16_t v)
+{
+    emit8(e, v & 0xff);
+    emit8(e, v >> 8);
+}
+
+static void emit32(struct emitter* e, uint32_t v)
+{
+    emit16(e, v & 0xffff);
+    emit16(e, v >> 16);
+}
+
+static void emit64(struct emitter* e, uint64_t v)
+{
+    emit32(e, v & 0xffffffff);
+    emit32(e, v >> 32);
+}
+
+/* <op> reg8, [rbx + disp] or <op> [rbx + disp], reg8 depending on the opcode */
+static void emit_rm8(struct emitter* e, uint8_t opcode, uint8_t reg, int32_t disp)
+{
+    emit8(e, opcode);
+    emit8(e, RBX_DISP32(reg));
+    emit32(e, disp);
+}
+
+/* mov byte [rbx + disp], imm8 */
+static void emit_store_imm8(struct emitter* e, int32_t disp, uint8_t imm)
+{
+    emit_rm8(e, 0xC6, 0, disp);
+    emit8(e, imm);
+}
+
+/* mov word [rbx + disp], imm16 */
+static void emit_store_imm16(struct emitter* e, int32_t disp, uint16_t imm)
+{
+    emit8(e, 0x66);
+    emit_rm8(e, 0xC7, 0, disp);
+    emit16(e, imm);
+}
+
+/* copies one byte register of chip8_sys to another through al */
+static void emit_copy8(struct emitter* e, int32_t dst, int32_t src)
+{
+    emit_rm8(e, 0x8A, AL, src);
+    emit_rm8(e, 0x88, AL, dst);
+}
+
+/* VX = VX <op> VY for the ALU instructions that set VF. arith is the opcode
+ * of "<op> al, [rbx + disp]" and setcc selects how VF is derived from CF */
+static void emit_alu_flag(struct emitter* e, uint8_t arith, uint8_t setcc, int32_t first, int32_t second, int32_t dst)
+{
+    emit_rm8(e, 0x8A, AL, first);
+    emit_rm8(e, arith, AL, second);
+    emit8(e, 0x0F);
+    emit8(e, setcc);
+    emit8(e, 0xC0 | CL);
+    emit_rm8(e, 0x88, AL, dst);
+    emit_rm8(e, 0x88, CL, OFF_V(0xF));
+}
+
+/* sets PC to taken if the flags say so (cmov condition cc), next otherwise */
+static void emit_conditional_pc(struct emitter* e, uint8_t cmov, uint16_t next, uint16_t taken)
+{
+    emit8(e, 0xB9); /* mov ecx, next */
+    emit32(e, next);
+    emit8(e, 0xBA); /* mov edx, taken */
+    emit32(e, taken);
+    emit8(e, 0x0F); /* cmovcc ecx, edx */
+    emit8(e, cmov);
+    emit8(e, 0xCA);
+    emit8(e, 0x66); /* mov [PC], cx */
+    emit_rm8(e, 0x89, CL, OFF_PC);
+}
+
+/* executes one instruction through the interpreter, called from compiled code */
+static void jit_step(struct state* s)
+{
+    fetch(s);
+    decode_execute(s);
+}
+
+/* sets PC to the instruction and calls jit_step(s) */
+static void emit_interpret(struct emitter* e, uint16_t address)
+{
+    emit_store_imm16(e, OFF_PC, address);
+    emit8(e, 0x4C); /* mov rdi, r12 */
+    emit8(e, 0x89);
+    emit8(e, 0xE7);
+    emit8(e, 0x48); /* mov rax, jit_step */
+    emit8(e, 0xB8);
+    emit64(e, (uint64_t)(uintptr_t)jit_step);
+    emit8(e, 0xFF); /* call rax */
+    emit8(e, 0xD0);
+}
+
+static void emit_prologue(struct emitter* e)
+{
+    emit8(e, 0x53); /* push rbx */
+    emit8(e, 0x41); /* push r12 */
+    emit8(e, 0x54);
+    emit8(e, 0x48); /* sub rsp, 8 - keeps the stack 16 byte aligned for calls */
+    emit8(e, 0x83);
+    emit8(e, 0xEC);
+    emit8(e, 0x08);
+    emit8(e, 0x49); /* mov r12, rdi */
+    emit8(e, 0x89);
+    emit8(e, 0xFC);
+    emit8(e, 0x48); /* mov rbx, [rdi + offsetof(struct state, chip8)] */
+    emit8(e, 0x8B);
+    emit8(e, 0x9F);
+    emit32(e, offsetof(struct state, chip8));
+}
+
+static void emit_epilogue(struct emitter* e, uint32_t count)
+{
+    emit8(e, 0xB8); /* mov eax, count */
+    emit32(e, count);
+    emit8(e, 0x48); /* add rsp, 8 */
+    emit8(e, 0x83);
+    emit8(e, 0xC4);
+    emit8(e, 0x08);
+    emit8(e, 0x41); /* pop r12 */
+    emit8(e, 0x5C);
+    emit8(e, 0x5B); /* pop rbx */
+    emit8(e, 0xC3); /* ret */
+}
+
+/* emits the native code for the instruction at address.
+ * returns TRUE when the instruction ends the block, in which case PC has
+ * already been set by the emitted code */
+static Bool emit_instruction(struct emitter* e, uint16_t opcode, uint16_t address)
+{
+    const uint16_t NNN = opcode & 0x0fff;
+    const uint8_t NN = opcode & 0xff;
+    const uint8_t X = (opcode >> 8) & 0xf;
+    const uint8_t Y = (opcode >> 4) & 0xf;
+    const uint16_t next = address + 2;
+
+    switch (opcode >> 12) {
+        case 0x1:
+            emit_store_imm16(e, OFF_PC, NNN);
+            return TRUE;
+
+        case 0x3:
+        case 0x4:
+            emit_rm8(e, 0x80, 7, OFF_V(X)); /* cmp byte [VX], NN */
+            emit8(e, NN);
+            emit_conditional_pc(e, (opcode >> 12) == 0x3 ? 0x44 : 0x45, next, next + 2);
+            return TRUE;
+
+        case 0x5:
+        case 0x9:
+            emit_rm8(e, 0x8A, AL, OFF_V(X));
+            emit_rm8(e, 0x3A, AL, OFF_V(Y)); /* cmp al, [VY] */
+            emit_conditional_pc(e, (opcode >> 12) == 0x5 ? 0x44 : 0x45, next, next + 2);
+            return TRUE;
+
+        case 0x6:
+            emit_store_imm8(e, OFF_V(X), NN);
+            return FALSE;
+
+        case 0x7:
+            emit_rm8(e, 0x80, 0, OFF_V(X)); /* add byte [VX], NN */
+            emit8(e, NN);
+            return FALSE;
+
+        case 0x8: {
+            /* the flag setting instructions are left to the interpreter when
+             * VF is an operand, the order of the writes matters there */
+            const Bool vf_operand = (X == 0xF || Y == 0xF);
+
+            switch (opcode & 0xf) {
+                case 0x0:
+                    emit_copy8(e, OFF_V(X), OFF_V(Y));
+                    return FALSE;
+
+                case 0x1:
+                case 0x2:
+                case 0x3: {
+                    static const uint8_t ops[] = {[0x1] = 0x08, [0x2] = 0x20, [0x3] = 0x30};
+                    emit_rm8(e, 0x8A, AL, OFF_V(Y));
+                    emit_rm8(e, ops[opcode & 0xf], AL, OFF_V(X)); /* or/and/xor [VX], al */
+                    return FALSE;
+                }
+
+                case 0x4:
+                    if (vf_operand)
+                        break;
+                    emit_alu_flag(e, 0x02, 0x92, OFF_V(X), OFF_V(Y), OFF_V(X)); /* add, setc */
+                    return FALSE;
+
+                case 0x5:
+                    if (vf_operand)
+                        break;
+                    emit_alu_flag(e, 0x2A, 0x93, OFF_V(X), OFF_V(Y), OFF_V(X)); /* sub, setnc */
+                    return FALSE;
+
+                case 0x7:
+                    if (vf_operand)
+                        break;
+                    emit_alu_flag(e, 0x2A, 0x93, OFF_V(Y), OFF_V(X), OFF_V(X)); /* sub, setnc */
+                    return FALSE;
+            }
+            break;
+        }
+
+        case 0xA:
+            emit_store_imm16(e, OFF_I, NNN);
+            return FALSE;
+
+        case 0xF:
+            switch (NN) {
+                case 0x07:
+                    emit_copy8(e, OFF_V(X), OFF_DT);
+                    return FALSE;
+
+                case 0x15:
+                    emit_copy8(e, OFF_DT, OFF_V(X));
+                    return FALSE;
+
+                case 0x18:
+                    emit_copy8(e, OFF_ST, OFF_V(X));
+                    return FALSE;
+
+                case 0x1E:
+                    emit8(e, 0x0F); /* movzx eax, byte [VX] */
+                    emit_rm8(e, 0xB6, AL, OFF_V(X));
+                    emit8(e, 0x66); /* add [I], ax */
+                    emit_rm8(e, 0x01, AL, OFF_I);
+                    return FALSE;
+
+                case 0x29:
+                    emit8(e, 0x0F); /* movzx eax, byte [VX] */
+                    emit_rm8(e, 0xB6, AL, OFF_V(X));
+                    emit8(e, 0x83); /* and eax, 15 */
+                    emit8(e, 0xE0);
+                    emit8(e, 0x0F);
+                    emit8(e, 0x8D); /* lea eax, [rax + rax * 4] */
+                    emit8(e, 0x04);
+                    emit8(e, 0x80);
+                    emit8(e, 0x66); /* mov [I], ax */
+                    emit_rm8(e, 0x89, AL, OFF_I);
+                    return FALSE;
+            }
+            break;
+    }
+
+    /* everything else runs in the interpreter */
+    emit_interpret(e, address);
+
+    switch (opcode >> 12) {
+        case 0x0:
+            return opcode == 0x00EE;
+
+        case 0x2:
+        case 0xB:
+        case 0xE:
+            return TRUE;
+
+        case 0xF:
+            return NN == 0x0A || NN == 0x33 || NN == 0x55;
+    }
+
+    return FALSE;
+}
+
+static void flush(struct jit* jit)
+{
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->covered, 0, sizeof(jit->covered));
+    jit->used = 0;
+    jit->flushes++;
+}
+
+/* compiles the block that starts at address */
+static jit_block compile_block(struct jit* jit, const struct chip8_sys* chip8, uint16_t address)
+{
+    if (jit->used + MAX_BLOCK_BYTES > CODE_BUFFER_SIZE)
+        flush(jit);
+
+    struct emitter e = {.p = jit->code + jit->used};
+    uint8_t* start = e.p;
+    uint32_t count = 0;
+    uint16_t pc = address;
+    Bool ended = FALSE;
+
+    emit_prologue(&e);
+
+    while (!ended && count < MAX_BLOCK_INSTRUCTIONS && pc < MEMSIZE - 1) {
+        uint16_t opcode = (chip8->memory[pc] << 8) | chip8->memory[pc + 1];
+
+        ended = emit_instruction(&e, opcode, pc);
+        jit->covered[pc / 64] |= 1ull << (pc % 64);
+        jit->covered[(pc + 1) / 64] |= 1ull << ((pc + 1) % 64);
+
+        count++;
+        pc += 2;
+    }
+
+    /* a block that can not be entered at all (the last byte of memory)
+     * is executed by the interpreter instead */
+    if (count == 0)
+        return NULL;
+
+    if (!ended)
+        emit_store_imm16(&e, OFF_PC, pc);
+
+    emit_epilogue(&e, count);
+
+    jit->used += e.p - start;
+    jit->blocks[address] = (jit_block)(void*)start;
+    jit->block_len[address] = count;
+    jit->compiled++;
+
+    return jit->blocks[address];
+}
+
+struct jit* jit_create(void)
+{
+    struct jit* jit = calloc(1, sizeof(*jit));
+    if (jit == NULL)
+        return NULL;
+
+    jit->code = mmap(NULL, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->code == MAP_FAILED) {
+        free(jit);
+        return NULL;
+    }
+
+    return jit;
+}
+
+void jit_destroy(struct jit* jit)
+{
+    if (jit == NULL)
+        return;
+
+    munmap(jit->code, CODE_BUFFER_SIZE);
+    free(jit);
+}
+
+uint64_t jit_run(struct state* s, uint64_t budget)
+{
+    struct jit* jit = s->jit;
+    uint64_t done = 0;
+
+    while (done < budget) {
+        uint16_t pc = s->chip8->program_counter;
+
+        /* a PC that ran past the end of memory is left to the interpreter,
+         * the blocks only know about addresses inside it */
+        if (pc >= MEMSIZE) {
+            jit_step(s);
+            done++;
+            continue;
+        }
+
+        jit_block block = jit->blocks[pc];
+
+        if (block == NULL)
+            block = compile_block(jit, s->chip8, pc);
+
+        /* blocks end at jumps and FX0A, so an idle loop is a whole block
+         * and is noticed before it goes round again */
+        if (block && jit->block_len[pc] <= IDLE_LOOP_LENGTH) {
+            uint64_t skipped = idle_skip(s, budget - done);
+
+            if (skipped) {
+                done += skipped;
+                continue;
+            }
+        }
+
+        /* blocks can not be left half way, single step the tail of the budget */
+        if (block == NULL || jit->block_len[pc] > budget - done) {
+            jit_step(s);
+            done++;
+            continue;
+        }
+
+        done += block(s);
+    }
+
+    return done;
+}
+
+void jit_invalidate(struct jit* jit, uint16_t addr, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++) {
+        uint16_t a = (addr + i) & (MEMSIZE - 1);
+
+        if (jit->covered[a / 64] & (1ull << (a % 64))) {
+            flush(jit);
+            return;
+        }
+    }
+}
+
+void jit_print_stats(const struct jit* jit)
+{
+    fprintf(stdout, GREEN_2 "jit: %" PRIu64 " blocks compiled, %" PRIu64 " cache flushes\n" RESET, jit->compiled,
+            jit->flushes);
+}
+
+#else
+
+struct jit* jit_create(void)
+{
+    return NULL;
+}
+
+void jit_destroy(struct jit* jit)
+{
+    (void)jit;
+}
+
+uint64_t jit_run(struct state* s, uint64_t budget)
+{
+    (void)s;
+    (void)budget;
+    return 0;
+}
+
+void jit_invalidate(struct jit* jit, uint16_t addr, uint16_t len)
+{
+    (void)jit;
+    (void)addr;
+    (void)len;
+}
+
+void jit_print_stats(const struct jit* jit)
+{
+    (void)jit;
+}
+
+#endif
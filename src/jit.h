@@ -0,0 +1,35 @@
+#ifndef REBORN_JIT_H
+#define REBORN_JIT_H
+
+#include "chip.h"
+
+/**
+ * Basic block recompiler for x86-64.
+ **
+ * A block starts at the address it is entered at and runs until the first
+ * instruction that can change control flow (1NNN, 2NNN, 00EE, BNNN, the skips,
+ * EX9E, EXA1, FX0A) or write memory (FX33, FX55). Simple register instructions
+ * are emitted as native code, everything else calls back into the interpreter.
+ * Every compiled block always executes all of its instructions, so the number
+ * of instructions it retires is known before it is entered.
+ **/
+
+/* allocates the block cache and its executable code buffer,
+ * returns NULL when the host is not x86-64 or the buffer cannot be mapped */
+struct jit* jit_create(void);
+
+/* unmaps the code buffer and frees the block cache */
+void jit_destroy(struct jit* jit);
+
+/* runs exactly budget instructions, compiling blocks on first entry,
+ * returns the number of instructions executed */
+uint64_t jit_run(struct state* s, uint64_t budget);
+
+/* drops every compiled block when memory[addr] .. memory[addr + len - 1]
+ * overlaps code that has been compiled */
+void jit_invalidate(struct jit* jit, uint16_t addr, uint16_t len);
+
+/* prints the number of compiled blocks and cache flushes to stdout */
+void jit_print_stats(const struct jit* jit);
+
+#endif
@@ -1,92 +1,176 @@
+#define _DEFAULT_SOURCE
+
 #include "keyboard.h"
 #include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    /* set in the entries of host keys that are mapped, the keypad key is the
+     * low nibble */
+    KEY_MAPPED = 0x10,
+    KEYMAP_FILE_SIZE = 4096,
+};
+
+// clang-format off
+static uint8_t keymap[SDL_NUM_SCANCODES] = {
+    [SDL_SCANCODE_1] = KEY_MAPPED | 0x1, [SDL_SCANCODE_2] = KEY_MAPPED | 0x2,
+    [SDL_SCANCODE_3] = KEY_MAPPED | 0x3, [SDL_SCANCODE_4] = KEY_MAPPED | 0xC,
+    [SDL_SCANCODE_Q] = KEY_MAPPED | 0x4, [SDL_SCANCODE_W] = KEY_MAPPED | 0x5,
+    [SDL_SCANCODE_E] = KEY_MAPPED | 0x6, [SDL_SCANCODE_R] = KEY_MAPPED | 0xD,
+    [SDL_SCANCODE_A] = KEY_MAPPED | 0x7, [SDL_SCANCODE_S] = KEY_MAPPED | 0x8,
+    [SDL_SCANCODE_D] = KEY_MAPPED | 0x9, [SDL_SCANCODE_F] = KEY_MAPPED | 0xE,
+    [SDL_SCANCODE_Z] = KEY_MAPPED | 0xA, [SDL_SCANCODE_X] = KEY_MAPPED | 0x0,
+    [SDL_SCANCODE_C] = KEY_MAPPED | 0xB, [SDL_SCANCODE_V] = KEY_MAPPED | 0xF,
+};
+// clang-format on
+
+/* how many of the host keys mapped to each keypad key are held, so that
+ * letting go of one of them does not let go of the keypad key */
+static uint8_t held[KEYS];
+
+static char* trim(char* text)
+{
+    text += strspn(text, " \t\r");
 
-void check_and_modify_keystate(const Uint8* SDL_Keyboard_State, struct state* const emulator_state)
+    size_t len = strlen(text);
+    while (len && strchr(" \t\r", text[len - 1]))
+        text[--len] = '\0';
+
+    return text;
+}
+
+/* applies one K=NAME entry, replaced has a bit for every keypad key whose
+ * default host key is gone already */
+static int apply_entry(char* entry, uint16_t* replaced)
 {
-    assert(emulator_state);
-    assert(SDL_Keyboard_State);
+    entry = trim(entry);
+    if (*entry == '\0')
+        return 0;
 
-    /* 1    2    3    4*/
-    if (SDL_Keyboard_State[SDL_SCANCODE_1])
-        emulator_state->keystates[0x1] = UP;
-    else
-        emulator_state->keystates[0x1] = DOWN;
+    char* name = strchr(entry, '=');
+    if (name == NULL) {
+        fprintf(stdout, RED_2 "chip8-rb: error: keymap entry '%s' is not KEY=NAME\n" RESET, entry);
+        return BAD_RETURN_VALUE;
+    }
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_2])
-        emulator_state->keystates[0x2] = UP;
-    else
-        emulator_state->keystates[0x2] = DOWN;
+    *name++ = '\0';
+    name = trim(name);
+    entry = trim(entry);
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_3])
-        emulator_state->keystates[0x3] = UP;
-    else
-        emulator_state->keystates[0x3] = DOWN;
+    char* end;
+    unsigned long key = strtoul(entry, &end, BASE_16);
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_4])
-        emulator_state->keystates[0xC] = UP;
-    else
-        emulator_state->keystates[0xC] = DOWN;
+    if (end == entry || *end != '\0' || key >= KEYS) {
+        fprintf(stdout, RED_2 "chip8-rb: error: '%s' is not a keypad key, 0 to F\n" RESET, entry);
+        return BAD_RETURN_VALUE;
+    }
 
-    /* Q    W    E    R */
-    if (SDL_Keyboard_State[SDL_SCANCODE_Q])
-        emulator_state->keystates[0x4] = UP;
-    else
-        emulator_state->keystates[0x4] = DOWN;
+    SDL_Scancode scancode = SDL_GetScancodeFromName(name);
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_W])
-        emulator_state->keystates[0x5] = UP;
-    else
-        emulator_state->keystates[0x5] = DOWN;
+    if (scancode == SDL_SCANCODE_UNKNOWN) {
+        fprintf(stdout, RED_2 "chip8-rb: error: unknown host key '%s' in the keymap\n" RESET, name);
+        return BAD_RETURN_VALUE;
+    }
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_E])
-        emulator_state->keystates[0x6] = UP;
-    else
-        emulator_state->keystates[0x6] = DOWN;
+    if (!(*replaced & (1u << key))) {
+        for (int i = 0; i < SDL_NUM_SCANCODES; i++)
+            if (keymap[i] == (KEY_MAPPED | key))
+                keymap[i] = 0;
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_R])
-        emulator_state->keystates[0xD] = UP;
-    else
-        emulator_state->keystates[0xD] = DOWN;
+        *replaced |= 1u << key;
+    }
 
-    /* A    S    D    F */
-    if (SDL_Keyboard_State[SDL_SCANCODE_A])
-        emulator_state->keystates[0x7] = UP;
-    else
-        emulator_state->keystates[0x7] = DOWN;
+    keymap[scancode] = KEY_MAPPED | key;
+    return 0;
+}
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_S])
-        emulator_state->keystates[0x8] = UP;
-    else
-        emulator_state->keystates[0x8] = DOWN;
+int load_keymap(const char* map)
+{
+    char text[KEYMAP_FILE_SIZE];
+    const char* separators = ",";
+
+    if (strchr(map, '=')) {
+        snprintf(text, sizeof(text), "%s", map);
+    } else {
+        FILE* fp = fopen(map, "r");
+
+        if (fp == NULL) {
+            fprintf(stdout, RED_2 "chip8-rb: error: Could not open keymap %s: %s\n" RESET, map, strerror(errno));
+            return BAD_RETURN_VALUE;
+        }
+
+        size_t size = fread(text, 1, sizeof(text) - 1, fp);
+        Bool larger = !feof(fp);
+        fclose(fp);
+
+        if (larger) {
+            fprintf(stdout, RED_2 "chip8-rb: error: keymap %s is larger than %d bytes\n" RESET, map,
+                    KEYMAP_FILE_SIZE - 1);
+            return BAD_RETURN_VALUE;
+        }
+
+        text[size] = '\0';
+        separators = "\n";
+    }
+
+    uint16_t replaced = 0;
+    char* cursor;
+
+    for (char* entry = strtok_r(text, separators, &cursor); entry; entry = strtok_r(NULL, separators, &cursor)) {
+        char* comment = strchr(entry, '#');
+        if (comment)
+            *comment = '\0';
+
+        if (apply_entry(entry, &replaced) == BAD_RETURN_VALUE)
+            return BAD_RETURN_VALUE;
+    }
+
+    return 0;
+}
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_D])
-        emulator_state->keystates[0x9] = UP;
-    else
-        emulator_state->keystates[0x9] = DOWN;
+uint16_t keypad_bit(SDL_Scancode scancode)
+{
+    if ((unsigned int)scancode >= SDL_NUM_SCANCODES || !keymap[scancode])
+        return 0;
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_F])
-        emulator_state->keystates[0xE] = UP;
-    else
-        emulator_state->keystates[0xE] = DOWN;
+    return 1u << (keymap[scancode] & 0xF);
+}
 
-    /* Z    X    C    V */
-    if (SDL_Keyboard_State[SDL_SCANCODE_Z])
-        emulator_state->keystates[0xA] = UP;
-    else
-        emulator_state->keystates[0xA] = DOWN;
+void modify_keystate(struct state* const emulator_state, SDL_Scancode scancode, Bool pressed)
+{
+    assert(emulator_state);
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_X])
-        emulator_state->keystates[0x0] = UP;
-    else
-        emulator_state->keystates[0x0] = DOWN;
+    if (!keypad_bit(scancode))
+        return;
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_C])
-        emulator_state->keystates[0xB] = UP;
-    else
-        emulator_state->keystates[0xB] = DOWN;
+    uint8_t key = keymap[scancode] & 0xF;
 
-    if (SDL_Keyboard_State[SDL_SCANCODE_V])
-        emulator_state->keystates[0xF] = UP;
+    if (pressed)
+        held[key]++;
+    else if (held[key])
+        held[key]--;
+
+    if (held[key])
+        emulator_state->keys |= 1u << key;
     else
-        emulator_state->keystates[0xF] = DOWN;
+        emulator_state->keys &= ~(1u << key);
+}
+
+void check_and_modify_keystate(const Uint8* SDL_Keyboard_State, struct state* const emulator_state)
+{
+    assert(emulator_state);
+    assert(SDL_Keyboard_State);
+
+    memset(held, 0, sizeof(held));
+    emulator_state->keys = 0;
+
+    for (int i = 0; i < SDL_NUM_SCANCODES; i++) {
+        if (keymap[i] && SDL_Keyboard_State[i]) {
+            held[keymap[i] & 0xF]++;
+            emulator_state->keys |= 1u << (keymap[i] & 0xF);
+        }
+    }
 }
@@ -3,14 +3,43 @@
 
 #include "chip.h"
 
+#include <SDL2/SDL.h>
+
+/**
+ * The keymap, which host keys press which keys of the keypad.
+ **
+ * It is a table with an entry per SDL scancode. By default the left hand side
+ * of a QWERTY keyboard is the keypad:
+ *
+ *   1 2 3 4        1 2 3 C
+ *   Q W E R   ->   4 5 6 D
+ *   A S D F        7 8 9 E
+ *   Z X C V        A 0 B F
+ *
+ * load_keymap() changes it with entries like 5=Up, a keypad key in hex and
+ * the SDL name of a host key. The first entry for a keypad key takes away
+ * its default host key, further ones add more host keys to it.
+ **/
+
+/* applies the entries in map, separated by commas, or in the file map names
+ * when it has no '=' in it, one per line with '#' starting a comment.
+ * returns BAD_RETURN_VALUE after printing what is wrong with it */
+int load_keymap(const char* map);
+
+/* the bit of the keypad key that scancode is mapped to, 0 when it is not */
+uint16_t keypad_bit(SDL_Scancode scancode);
+
+/* sets or clears the bit of the keypad key that scancode is mapped to, from
+ * an SDL_KEYDOWN or SDL_KEYUP that is not a repeat */
+void modify_keystate(struct state* const emulator_state, SDL_Scancode scancode, Bool pressed);
+
 /**
  * Parameters :
  * state of keyboard as an array of Uint8 pointer,
  * current emulator structure in the 'state' structure
  **
- * Modifies the keystates array in emulator state
- * sets keystates in emulator structure by looking at the keyboard state
- *received
+ * Sets the whole keypad from the keyboard state, for when the keypad was
+ * replaced by loading a state and has to match the keys held again
  **/
 void check_and_modify_keystate(const Uint8* SDL_Keyboard_State, struct state* const emulator_state);
 
@@ -0,0 +1,85 @@
+#ifndef REBORN_LIBCHIP8_H
+#define REBORN_LIBCHIP8_H
+
+#include <stddef.h>
+#include "chip.h"
+
+/**
+ * The emulator core as a library, built as libchip8.a.
+ **
+ * Every emulator is a struct state created by chip8_create(), which owns its
+ * memory, registers, decode cache and native code. Nothing is shared between
+ * instances and nothing here calls SDL or exits, failures are reported with
+ * BAD_RETURN_VALUE (and errno where a file was involved), so any number of
+ * instances can be run side by side in one process, each from one thread.
+ * Given the same seed and input an instance always runs the same way.
+ **/
+
+/* creates an instance with the font loaded, the PC at 0x200 and the switch
+ * core selected, data is copied, with the watchdog running when
+ * data->watchdog is set. returns NULL when out of memory */
+struct state* chip8_create(const struct chip8_launch_data* data);
+
+/* restarts the CXNN random number generator from seed, the same seed
+ * always gives the same sequence. chip8_create() seeds with data->seed */
+void chip8_seed(struct state* s, uint64_t seed);
+
+/* frees an instance and the native code of its core */
+void chip8_destroy(struct state* s);
+
+/* loads the ROM file at path to 0x200, returns its size in bytes or
+ * BAD_RETURN_VALUE with errno set when it cannot be read or does not fit */
+int chip8_load_rom(struct state* s, const char* path);
+
+/* the same with a ROM that is already in memory */
+int chip8_load_rom_mem(struct state* s, const uint8_t* rom, size_t size);
+
+/* selects one of the cores in enum cores, call after the ROM is loaded.
+ * returns BAD_RETURN_VALUE and keeps the switch core when the JIT is not
+ * available on this host or the AOT library (data->aot_lib) does not load */
+int chip8_set_core(struct state* s, uint8_t core);
+
+/**
+ * Save states.
+ **
+ * A save state is everything an instance needs to carry on exactly where it
+ * was: the machine including the random number generator, the keypad and the
+ * frame scheduler. It is written and read as one block, so files only move
+ * between builds with the same structure layout, which the magic, version and
+ * size fields check. CHIP8_STATE_VERSION changes whenever the layout does.
+ **/
+enum { CHIP8_STATE_VERSION = 2 };
+
+struct chip8_savestate {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    struct chip8_sys chip8;
+    uint16_t keys;
+    uint64_t budget_carry;
+    uint64_t cycles;
+    uint64_t frames;
+};
+
+/* copies the state of an instance into out */
+void chip8_save_state(const struct state* s, struct chip8_savestate* out);
+
+/* puts an instance back into a saved state, dropping the decoded and native
+ * code of memory that differs. returns BAD_RETURN_VALUE with errno set to
+ * EINVAL when the state is from another version */
+int chip8_load_state(struct state* s, const struct chip8_savestate* in);
+
+/* the same to and from a file, BAD_RETURN_VALUE with errno set on failure */
+int chip8_write_state(const struct state* s, const char* path);
+int chip8_read_state(struct state* s, const char* path);
+
+/* executes one frame worth of instructions, frequency / 60 of them, then
+ * decrements the timers. the fraction that did not fit in this frame is carried
+ * over to the next one so that the requested frequency is met exactly.
+ * clears s->run once the cycle or frame limit has been reached, or once the
+ * watchdog found the instance going round a loop for ever. when s->debug
+ * stops part way through the frame the rest of it runs on the next call after
+ * debug_resume(), until then calls return without running anything */
+void chip8_run_frame(struct state* s);
+
+#endif
@@ -0,0 +1,540 @@
+#include "options.h"
+#include "helpers.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void print_help(void)
+{
+    puts(BOLD GREEN_2
+         "Dy-Chip8-Reborn\n"
+         "Usage: chip8-rb [OPTIONS]\n\n" RESET BOLD "Options:\n" RESET
+         "  --help             Shows this help page\n"
+         "  --rom [PATH]       Specify path to chip8 ROM file\n"
+         "  --quirks           Enables specific quirks in emulator\n"
+         "  --freq             Specify the frequency at which the emulated cpu runs\n"
+         "  --debug            Stop in a console debugger before the first instruction, with\n"
+         "                     breakpoints, watchpoints on memory, stepping and disassembly\n"
+         "  --colors [BG] [FG] Specify the background and the foreground color\n"
+         "  --headless         Run without a window, dump the machine state on exit\n"
+         "  --cycles [N]       Stop after N instructions have been executed\n"
+         "  --frames [N]       Stop after N frames (1/60th of a second each) have passed\n"
+         "  --core [NAME]      Select the interpreter core, 'switch' (default), 'threaded', 'jit' or 'aot',\n"
+         "                     which runs the library given with --aot-lib\n"
+         "  --jit              Run the x86-64 block recompiler, same as --core jit\n"
+         "  --aot [ROM] -o [F] Compile ROM ahead of time to the shared object F and exit\n"
+         "  --aot-lib [FILE]   Run the ROM with a shared object built by --aot\n"
+         "  --skip-same        Do not present frames that look the same as the last presented one\n"
+         "  --batch [FILE]     Run every ROM listed in FILE headless in parallel and print the results\n"
+         "  --threads [N]      Number of worker threads for --batch, default is one per CPU\n"
+         "  --seed [N]         Seed for the random numbers of CXNN, runs with the same seed repeat exactly\n"
+         "  --load-state [F]   Start from the save state in F, F5 and F9 then save to and load from F\n"
+         "  --save-state [F]   Save the state to F when the run ends\n"
+         "  --rewind [MB]      Size of the rewind history in megabytes, default is 8, 0 turns rewinding off\n"
+         "  --record [FILE]    Record the keypad to FILE so that the run can be replayed\n"
+         "  --replay [FILE]    Replay a recording headless at full speed, the ROM must be the recorded one\n"
+         "  --profile [FILE]   Count the instructions executed per address and per opcode, and write the\n"
+         "                     hottest addresses with their disassembly to FILE at exit\n"
+         "  --trace [FILE]     Record every instruction executed to FILE, read it with chip8-trace\n"
+         "  --watchdog         End --headless and --batch runs that only repeat themselves\n"
+         "  --keymap [MAP]     Remap the keypad, MAP is entries like 5=Up,8=Down or a file of them\n" BOLD RED_2
+         "\nAdditional Notes:\n" RESET
+         "  Quirks             There are instruction specific quirks that can be"
+         "enabled by specifying the option.\n"
+         "                     Most ROMs work well without the enable of these quirks.\n\n"
+         "  Freq               The cpu frequency is the number of instructions executed per second (hertz).\n"
+         "                     frequency / 60 instructions are run in every 60hz frame, default is 1000\n\n"
+         "  Colors             The foreground and background colors should both be specified\n"
+         "                     use hexadecimal base, append 'ff' at the end of your color's hex value\n\n"
+         "  Headless           No SDL calls are made in this mode, timers are driven by the emulated clock.\n"
+         "                     Either --cycles or --frames must be given so that the run terminates\n\n"
+         "  Save States        F5 saves the running machine and F9 loads it back, to ROM.state next to\n"
+         "                     the ROM unless --load-state names another file\n\n"
+         "  Rewind             Holding Backspace runs the emulator backwards a frame at a time, every frame\n"
+         "                     takes only the bytes it changed so 8MB hold several minutes\n\n"
+         "  Record             The recording holds the seed, frequency and quirks of the run. Rewinding and\n"
+         "                     loading states are off while recording, a run started with --load-state\n"
+         "                     has to be replayed with the same --load-state\n\n"
+         "  Batch              One job per line, a ROM path and optionally settings for that job only\n"
+         "                     cycles=N frames=N freq=N core=NAME quirks=0|1 seed=N watchdog=0|1, '#' starts\n"
+         "                     a comment. Prints rom, core, cycles, frames, display hash, PC, I, V0-VF and\n"
+         "                     instructions per second as one tab separated line per job\n\n"
+         "  Keymap             An entry is a keypad key in hex, '=' and the SDL name of a host key. The\n"
+         "                     first entry for a keypad key replaces its default key on the left hand\n"
+         "                     side of the keyboard (1234 QWER ASDF ZXCV), further ones add more keys.\n"
+         "                     A file has one entry per line, '#' starts a comment\n\n"
+         "  Watchdog           Samples the machine every 65536 instructions and stops the run once it is\n"
+         "                     exactly where it was a few samples before, as it would only go round the\n"
+         "                     same loop until --cycles or --frames, then prints where it halted\n");
+}
+
+void bad_arg(void)
+{
+    puts(RED_2 "dy-chip8: invalid usage.\n" RESET "Type 'dy-chip8 -h' for help");
+    exit(EXIT_FAILURE);
+}
+
+void parse_argv(const int argc, const char** argv, struct chip8_launch_data* data)
+{
+    char* options[] = {"--help",  "--rom",    "--quirks",   "--freq",   "--debug",
+                       "--colors", "-h",      "--headless", "--cycles", "--frames",
+                       "--core",   "--jit",   "--aot-lib",  "--aot",    "-o",
+                       "--skip-same", "--batch", "--threads", "--seed", "--load-state",
+                       "--save-state", "--rewind", "--record", "--replay", "--profile", "--trace",
+                       "--watchdog", "--keymap"};
+
+    enum OPTIONS {
+        HELP = 0,
+        ROM = 1,
+        QRK = 2,
+        FRQ = 3,
+        DBG = 4,
+        COL = 5,
+        HELP_2 = 6,
+        HDL = 7,
+        CYC = 8,
+        FRM = 9,
+        COR = 10,
+        JIT = 11,
+        AOL = 12,
+        AOT = 13,
+        OUT = 14,
+        SKP = 15,
+        BAT = 16,
+        THR = 17,
+        SED = 18,
+        LST = 19,
+        SST = 20,
+        RWD = 21,
+        REC = 22,
+        RPL = 23,
+        PRF = 24,
+        TRC = 25,
+        WDG = 26,
+        KMP = 27,
+
+        HELP_L = CP_STRLEN("--help"),
+        HELP_2_L = CP_STRLEN("-h"),
+        ROM_L = CP_STRLEN("--rom"),
+        QRK_L = CP_STRLEN("--quirks"),
+        FRQ_L = CP_STRLEN("--freq"),
+        DBG_L = CP_STRLEN("--debug"),
+        COL_L = CP_STRLEN("--colors"),
+        HDL_L = CP_STRLEN("--headless"),
+        CYC_L = CP_STRLEN("--cycles"),
+        FRM_L = CP_STRLEN("--frames"),
+        COR_L = CP_STRLEN("--core"),
+        JIT_L = CP_STRLEN("--jit"),
+        AOL_L = CP_STRLEN("--aot-lib"),
+        AOT_L = CP_STRLEN("--aot"),
+        OUT_L = CP_STRLEN("-o"),
+        SKP_L = CP_STRLEN("--skip-same"),
+        BAT_L = CP_STRLEN("--batch"),
+        THR_L = CP_STRLEN("--threads"),
+        SED_L = CP_STRLEN("--seed"),
+        LST_L = CP_STRLEN("--load-state"),
+        SST_L = CP_STRLEN("--save-state"),
+        RWD_L = CP_STRLEN("--rewind"),
+        REC_L = CP_STRLEN("--record"),
+        RPL_L = CP_STRLEN("--replay"),
+        PRF_L = CP_STRLEN("--profile"),
+        TRC_L = CP_STRLEN("--trace"),
+        WDG_L = CP_STRLEN("--watchdog"),
+        KMP_L = CP_STRLEN("--keymap")
+    };
+
+    size_t index = 1;
+    while (index < (size_t)argc) {
+        if (strncmp(options[HELP], argv[index], HELP_L) == 0 || strncmp(options[HELP_2], argv[index], HELP_2_L) == 0) {
+            print_help();
+            exit(EXIT_SUCCESS);
+        }
+
+        if (strncmp(options[ROM], argv[index], ROM_L) == 0) {
+            index++;
+
+            if ((index >= (size_t)argc))
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->rom_path = argv[index];
+            data->yes_rom = TRUE;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[QRK], argv[index], QRK_L) == 0) {
+            data->quirks = TRUE;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[DBG], argv[index], DBG_L) == 0) {
+            data->debugger = TRUE;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[FRQ], argv[index], FRQ_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->frequency = strtoul(argv[index], NULL, 10);
+            if (data->frequency < 1) {
+                fprintf(stdout, RED_2 "chip8-rb: error: Invalid argument for frequency\n" RESET);
+                bad_arg();
+            }
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[HDL], argv[index], HDL_L) == 0) {
+            data->headless = TRUE;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[SKP], argv[index], SKP_L) == 0) {
+            data->skip_same = TRUE;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[WDG], argv[index], WDG_L) == 0) {
+            data->watchdog = TRUE;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[CYC], argv[index], CYC_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->cycle_limit = strtoul(argv[index], NULL, 10);
+            if (data->cycle_limit < 1) {
+                fprintf(stdout, RED_2 "chip8-rb: error: Invalid argument for cycles\n" RESET);
+                bad_arg();
+            }
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[FRM], argv[index], FRM_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->frame_limit = strtoul(argv[index], NULL, 10);
+            if (data->frame_limit < 1) {
+                fprintf(stdout, RED_2 "chip8-rb: error: Invalid argument for frames\n" RESET);
+                bad_arg();
+            }
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[BAT], argv[index], BAT_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->batch_path = argv[index];
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[THR], argv[index], THR_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->threads = strtoul(argv[index], NULL, 10);
+            if (data->threads < 1) {
+                fprintf(stdout, RED_2 "chip8-rb: error: Invalid argument for threads\n" RESET);
+                bad_arg();
+            }
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[SED], argv[index], SED_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->seed = strtoull(argv[index], NULL, 0);
+            data->yes_seed = TRUE;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[LST], argv[index], LST_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->state_path = argv[index];
+            data->load_state = TRUE;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[SST], argv[index], SST_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->exit_state_path = argv[index];
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[RWD], argv[index], RWD_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->rewind_mb = strtoul(argv[index], NULL, 10);
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[REC], argv[index], REC_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->record_path = argv[index];
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[RPL], argv[index], RPL_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->replay_path = argv[index];
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[PRF], argv[index], PRF_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->profile_path = argv[index];
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[KMP], argv[index], KMP_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->keymap = argv[index];
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[TRC], argv[index], TRC_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->trace_path = argv[index];
+            index++;
+
+            continue;
+        }
+
+        /* --aot-lib has to be matched before its prefix --aot */
+        if (strncmp(options[AOL], argv[index], AOL_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->aot_lib = argv[index];
+            data->core = CORE_AOT;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[AOT], argv[index], AOT_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->aot_rom = argv[index];
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[OUT], argv[index], OUT_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->aot_out = argv[index];
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[JIT], argv[index], JIT_L) == 0) {
+            data->core = CORE_JIT;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[COR], argv[index], COR_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+
+            uint8_t core = 0;
+            while (core < CORE_COUNT && strcmp(core_names[core], argv[index]) != 0)
+                core++;
+
+            if (core == CORE_COUNT) {
+                fprintf(stdout, RED_2 "chip8-rb: error: Unknown core '%s'\n" RESET, argv[index]);
+                bad_arg();
+            }
+            data->core = core;
+            index++;
+
+            continue;
+        }
+
+        if (strncmp(options[COL], argv[index], COL_L) == 0) {
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->bg = strtol(argv[index], NULL, 16);
+
+            index++;
+
+            if (index >= (size_t)argc)
+                bad_arg();
+            if (argv[index][0] == '-')
+                bad_arg();
+
+            data->fg = strtol(argv[index], NULL, 16);
+
+            index++;
+
+            continue;
+        }
+
+        /* if nothing matches then bad argument*/
+        bad_arg();
+    }
+}
+
+void print_chip8_settings(const struct chip8_launch_data* data)
+{
+    // clang-format off
+    printf(BOLD ULINE GREEN"\n[Chip-8 Reborn]\nEmulator Settings\n\n" RESET
+        BLUE "%16s " RESET "- %15d\n"
+        BLUE "%16s " RESET "- %s\n"
+        BLUE "%16s " RESET "- %15x\n"
+        BLUE "%16s " RESET "- %15x\n"
+        BLUE "%16s " RESET "- %15lu Hz\n"
+        BLUE "%16s " RESET "- %15d\n"
+        BLUE "%16s " RESET "- %15d\n"
+        BLUE "%16s " RESET "- %15d\n"
+        BLUE "%16s " RESET "- %15s\n"
+        BLUE "%16s " RESET "- %15d\n"
+        BLUE "%16s " RESET "- %15" PRIu64 "\n"
+        GREEN_2 BOLD "\nLegend - 0 for Disabled, 1 for Enabled\n" RESET,
+        "Rom Available", data->yes_rom, "Rom Path", data->rom_path, "Fg",
+           data->fg, "Bg", data->bg, "Frequency", data->frequency,
+           "Qurks Enabled", data->quirks, "Debugger Enabled", data->debugger,
+           "Headless", data->headless, "Core", core_names[data->core],
+           "Skip Same", data->skip_same, "Seed", data->seed);
+    // clang-format on
+}
@@ -0,0 +1,16 @@
+#ifndef REBORN_OPTIONS_H
+#define REBORN_OPTIONS_H
+
+#include "chip.h"
+
+/* outputs bad usage error to terminal*/
+void bad_arg(void);
+
+/* parses the options passed to the emulator and sets up the runtime structure
+ */
+void parse_argv(const int argc, const char** argv, struct chip8_launch_data* data);
+
+/* prints out the chip8_launch_data structure to stdout */
+void print_chip8_settings(const struct chip8_launch_data* data);
+
+#endif
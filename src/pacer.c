@@ -0,0 +1,110 @@
+#define _DEFAULT_SOURCE
+
+#include "pacer.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <SDL2/SDL.h>
+#endif
+
+enum { NS_PER_SECOND = 1000000000 };
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+}
+
+/* sleeps until the monotonic clock reads at least until */
+static void sleep_until(uint64_t until)
+{
+#ifdef _WIN32
+    uint64_t now = monotonic_ns();
+    if (until > now)
+        SDL_Delay((until - now) / 1000000);
+#else
+    struct timespec ts = {.tv_sec = until / NS_PER_SECOND, .tv_nsec = until % NS_PER_SECOND};
+
+    /* the deadline is absolute, a signal only means sleeping again */
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+#endif
+}
+
+[[gnu::always_inline]] static inline uint64_t deadline(const struct pacer* p)
+{
+    return p->start + p->frame * NS_PER_SECOND / FRAME_RATE;
+}
+
+void pacer_start(struct pacer* p)
+{
+    memset(p, 0, sizeof(*p));
+    p->start = monotonic_ns();
+}
+
+void pacer_wait(struct pacer* p)
+{
+    uint64_t due = deadline(p);
+    uint64_t now = monotonic_ns();
+
+    if (now + PACER_SPIN_NS < due) {
+        sleep_until(due - PACER_SPIN_NS);
+        now = monotonic_ns();
+    }
+
+    uint64_t spin_start = now;
+    while (now < due)
+        now = monotonic_ns();
+
+    p->spin_ns += now - spin_start;
+
+    uint64_t late = now - due;
+
+    if (late > MAX_FRAME_LAG * (uint64_t)NS_PER_SECOND / FRAME_RATE) {
+        p->stalls++;
+        p->start = now;
+        p->frame = 1;
+        return;
+    }
+
+    /* bucket n holds everything under 2^n microseconds */
+    uint64_t us = late / 1000;
+    int bucket = us ? 64 - __builtin_clzll(us) : 0;
+
+    p->buckets[bucket < PACER_BUCKETS ? bucket : PACER_BUCKETS - 1]++;
+    p->late_ns += late;
+    p->frames++;
+    p->frame++;
+
+    if (late > p->max_late_ns)
+        p->max_late_ns = late;
+}
+
+void pacer_print_stats(const struct pacer* p)
+{
+    if (p->frames == 0)
+        return;
+
+    fprintf(stdout,
+            GREEN_2 "pacer: %" PRIu64 " frames started %.1fus late on average, %.1fus at worst, %" PRIu64
+                    " stalls, %.1fms spent spinning\n" RESET,
+            p->frames, p->late_ns / 1e3 / p->frames, p->max_late_ns / 1e3, p->stalls, p->spin_ns / 1e6);
+
+    for (int n = 0; n < PACER_BUCKETS; n++) {
+        if (p->buckets[n] == 0)
+            continue;
+
+        if (n == PACER_BUCKETS - 1)
+            fprintf(stdout, GREEN_2 "  %6dus and more %10" PRIu64 " %5.1f%%\n" RESET, 1 << (n - 1), p->buckets[n],
+                    100.0 * p->buckets[n] / p->frames);
+        else
+            fprintf(stdout, GREEN_2 "  under %6dus   %10" PRIu64 " %5.1f%%\n" RESET, 1 << n, p->buckets[n],
+                    100.0 * p->buckets[n] / p->frames);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef REBORN_PACER_H
+#define REBORN_PACER_H
+
+#include "chip.h"
+
+/**
+ * Frame pacer of the windowed loop.
+ **
+ * Frame n is due at start + n / FRAME_RATE seconds on CLOCK_MONOTONIC. The
+ * deadlines are absolute, so a wait that ends late does not push the frames
+ * after it back the way summing the time between frames does. A wait sleeps
+ * with clock_nanosleep() until PACER_SPIN_NS before the deadline, which the
+ * scheduler tends to overshoot by tens of microseconds, and spins on the clock
+ * for the rest.
+ *
+ * How late each frame started lands in a histogram with power of two buckets
+ * of microseconds. A loop that falls behind runs frames back to back until it
+ * caught up, unless it is more than MAX_FRAME_LAG frames behind, a stall like
+ * the debugger prompt, then the deadlines start over from the current time and
+ * the stall is counted instead of going into the histogram.
+ **/
+
+enum {
+    PACER_SPIN_NS = 200000,
+    /* under 1us, under 2us, ... and the last one everything longer */
+    PACER_BUCKETS = 18,
+};
+
+struct pacer {
+    uint64_t start;
+    /* frames since start, the next one is due at start + frame / FRAME_RATE */
+    uint64_t frame;
+
+    uint64_t frames;
+    uint64_t stalls;
+    uint64_t late_ns;
+    uint64_t max_late_ns;
+    uint64_t spin_ns;
+    uint64_t buckets[PACER_BUCKETS];
+};
+
+/* the first frame is due right away */
+void pacer_start(struct pacer* p);
+
+/* waits until the next frame is due */
+void pacer_wait(struct pacer* p);
+
+/* prints how late frames started on average and at worst, the time spent
+ * spinning and the histogram */
+void pacer_print_stats(const struct pacer* p);
+
+#endif
@@ -0,0 +1,78 @@
+#include "profile.h"
+#include "disasm.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+struct profile_entry {
+    uint64_t count;
+    uint16_t key;
+};
+
+struct profile* profile_create(void)
+{
+    return calloc(1, sizeof(struct profile));
+}
+
+void profile_destroy(struct profile* p)
+{
+    free(p);
+}
+
+/* hottest first, lower keys first among equals */
+static int compare_entries(const void* a, const void* b)
+{
+    const struct profile_entry* x = a;
+    const struct profile_entry* y = b;
+
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+
+    return (int)x->key - (int)y->key;
+}
+
+/* copies the non zero counters into entries sorted hottest first,
+ * returns how many there are */
+static size_t sort_counters(const uint64_t* counters, size_t len, struct profile_entry* entries)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < len; i++)
+        if (counters[i])
+            entries[count++] = (struct profile_entry){.count = counters[i], .key = i};
+
+    qsort(entries, count, sizeof(*entries), compare_entries);
+    return count;
+}
+
+void profile_write_report(const struct profile* p, const struct chip8_sys* chip8, FILE* fp)
+{
+    struct profile_entry entries[MEMSIZE];
+    uint64_t total = 0;
+
+    for (int i = 0; i <= INST_UNKNOWN; i++)
+        total += p->instructions[i];
+
+    /* percentages of nothing are 0, not NaN */
+    double scale = total ? 100.0 / total : 0;
+
+    fprintf(fp, "# %" PRIu64 " instructions\n\n# address, count, share, opcode, instruction\n", total);
+
+    size_t count = sort_counters(p->pc, MEMSIZE, entries);
+    for (size_t i = 0; i < count; i++) {
+        uint16_t address = entries[i].key;
+        uint16_t opcode = (chip8->memory[address] << 8) | chip8->memory[(address + 1) & (MEMSIZE - 1)];
+        char text[32];
+
+        disassemble(opcode, text, sizeof(text));
+        fprintf(fp, "0x%03X %12" PRIu64 " %6.2f%%  %04X  %s\n", address, entries[i].count, entries[i].count * scale,
+                opcode, text);
+    }
+
+    fprintf(fp, "\n# instruction, count, share\n");
+
+    count = sort_counters(p->instructions, INST_UNKNOWN + 1, entries);
+    for (size_t i = 0; i < count; i++)
+        fprintf(fp, "%s  %12" PRIu64 " %6.2f%%\n", instruction_names[entries[i].key], entries[i].count,
+                entries[i].count * scale);
+}
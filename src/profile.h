@@ -0,0 +1,32 @@
+#ifndef REBORN_PROFILE_H
+#define REBORN_PROFILE_H
+
+#include <stdio.h>
+#include "chip.h"
+
+/**
+ * Execution profiler.
+ **
+ * While s->profile is set chip8_run_frame() runs every instruction through a
+ * copy of the switch core that counts it twice, once for the address it was
+ * fetched from and once for the instruction it decoded to. The copy is made
+ * by the compiler, the core that runs without a profile has no counting in it.
+ **/
+
+struct profile {
+    uint64_t pc[MEMSIZE];
+    uint64_t instructions[INST_UNKNOWN + 1];
+};
+
+/* allocates a profile with all counters at 0, returns NULL when out of memory */
+struct profile* profile_create(void);
+
+/* frees the profile */
+void profile_destroy(struct profile* p);
+
+/* writes the executed addresses from the hottest down with the instruction
+ * at each, then the instruction mix, to fp. the instructions are disassembled
+ * from memory as it is now, so code that was overwritten shows the new bytes */
+void profile_write_report(const struct profile* p, const struct chip8_sys* chip8, FILE* fp);
+
+#endif
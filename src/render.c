@@ -0,0 +1,209 @@
+#include "render.h"
+#include "blit.h"
+#include "graphics.h"
+#include "helpers.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    SLOTS = 3,
+    /* set in the middle slot index while it holds a frame not yet picked up */
+    SLOT_FRESH = 0x4,
+    SLOT_INDEX = 0x3,
+};
+
+struct render {
+    /* each slot on its own cache lines, so that the two threads never write
+     * to the same line unless they are handing a slot over */
+    struct {
+        _Alignas(64) uint64_t rows[DISPH];
+        uint64_t input_ns;
+    } slots[SLOTS];
+
+    /* the only state shared between the two threads */
+    _Alignas(64) atomic_uint middle;
+    atomic_bool running;
+
+    /* owned by the emulator thread */
+    _Alignas(64) unsigned int back;
+
+    /* owned by the render thread */
+    _Alignas(64) unsigned int front;
+    struct sdl_objs* sdl_objs;
+    SDL_Thread* thread;
+    uint64_t presented;
+    struct input_latency latency;
+    uint32_t fg;
+    uint32_t bg;
+};
+
+/* swaps the front slot for the middle one if a frame was published since the
+ * last call, returns FALSE when there is nothing new to present */
+static Bool acquire_frame(struct render* r)
+{
+    if (!(atomic_load_explicit(&r->middle, memory_order_relaxed) & SLOT_FRESH))
+        return FALSE;
+
+    /* acquire the published rows, release the reads of the slot given back */
+    r->front = atomic_exchange_explicit(&r->middle, r->front, memory_order_acq_rel) & SLOT_INDEX;
+    return TRUE;
+}
+
+/* presents a published frame, uploading only the display rows that differ
+ * from what is in the texture. rows that were drawn to and then restored (a
+ * sprite drawn and erased in the same frame) are not uploaded */
+static void present_frame(struct render* r, const uint64_t* rows)
+{
+    struct sdl_objs* sdl_objs = r->sdl_objs;
+    uint32_t changed = 0;
+
+    for (int h = 0; h < DISPH; h++) {
+        if (rows[h] == sdl_objs->shown[h])
+            continue;
+
+        sdl_objs->shown[h] = rows[h];
+        expand_row(&sdl_objs->pixels[h * DISPW], rows[h], r->fg, r->bg);
+        changed |= 1u << h;
+    }
+
+    /* upload the rectangle spanning the first to the last changed row */
+    if (changed) {
+        int first = __builtin_ctz(changed);
+        int last = 31 - __builtin_clz(changed);
+        SDL_Rect rect = {.x = 0, .y = first, .w = DISPW, .h = last - first + 1};
+
+        SDL_UpdateTexture(sdl_objs->texture, &rect, &sdl_objs->pixels[first * DISPW],
+                          DISPW * sizeof(*sdl_objs->pixels));
+    }
+
+    SDL_RenderClear(sdl_objs->renderer);
+    SDL_RenderCopy(sdl_objs->renderer, sdl_objs->texture, NULL, NULL);
+    SDL_RenderPresent(sdl_objs->renderer);
+    r->presented++;
+}
+
+static void record_latency(struct input_latency* latency, uint64_t ns)
+{
+    uint64_t ms = ns / 1000000;
+
+    latency->count++;
+    latency->total_ns += ns;
+    latency->buckets[ms < LATENCY_BUCKETS ? ms : LATENCY_BUCKETS - 1]++;
+
+    if (ns > latency->max_ns)
+        latency->max_ns = ns;
+}
+
+static int render_loop(void* arg)
+{
+    struct render* r = arg;
+
+    /* the renderer belongs to the thread that created it */
+    create_renderer(r->sdl_objs, r->bg);
+
+    while (atomic_load_explicit(&r->running, memory_order_relaxed)) {
+        if (!acquire_frame(r)) {
+            SDL_Delay(1);
+            continue;
+        }
+
+        present_frame(r, r->slots[r->front].rows);
+
+        if (r->slots[r->front].input_ns)
+            record_latency(&r->latency, host_time_ns() - r->slots[r->front].input_ns);
+    }
+
+    destroy_renderer(r->sdl_objs);
+    return 0;
+}
+
+struct render* render_start(struct sdl_objs* sdl_objs, uint32_t fg, uint32_t bg)
+{
+    struct render* r = aligned_alloc(64, sizeof(*r));
+
+    if (r == NULL)
+        return NULL;
+
+    memset(r, 0, sizeof(*r));
+    r->sdl_objs = sdl_objs;
+    r->fg = fg;
+    r->bg = bg;
+
+    /* the texture starts out cleared to bg, which is what a blank display is */
+    memset(sdl_objs->shown, 0, sizeof(sdl_objs->shown));
+
+    r->front = 0;
+    atomic_init(&r->middle, 1);
+    r->back = 2;
+    atomic_init(&r->running, TRUE);
+
+    r->thread = SDL_CreateThread(render_loop, "render", r);
+
+    if (r->thread == NULL) {
+        free(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+uint64_t render_publish(struct render* r, const uint64_t display[DISPH], uint64_t input_ns)
+{
+    memcpy(r->slots[r->back].rows, display, sizeof(r->slots[r->back].rows));
+    r->slots[r->back].input_ns = input_ns;
+
+    /* the release pairs with the acquire in acquire_frame(), the slot that
+     * comes back is either the previous unread frame or one that the render
+     * thread has finished with */
+    unsigned int returned = atomic_exchange_explicit(&r->middle, r->back | SLOT_FRESH, memory_order_acq_rel);
+    r->back = returned & SLOT_INDEX;
+
+    return returned & SLOT_FRESH ? r->slots[r->back].input_ns : 0;
+}
+
+uint64_t render_stop(struct render* r, struct input_latency* latency)
+{
+    if (r == NULL)
+        return 0;
+
+    atomic_store_explicit(&r->running, FALSE, memory_order_relaxed);
+    SDL_WaitThread(r->thread, NULL);
+
+    if (latency)
+        *latency = r->latency;
+
+    uint64_t presented = r->presented;
+    free(r);
+    return presented;
+}
+
+/* the upper end of the bucket the given fraction of the events fall in */
+static int latency_percentile(const struct input_latency* latency, double fraction)
+{
+    uint64_t seen = 0;
+
+    for (int ms = 0; ms < LATENCY_BUCKETS; ms++) {
+        seen += latency->buckets[ms];
+
+        if (seen >= fraction * latency->count)
+            return ms + 1;
+    }
+
+    return LATENCY_BUCKETS;
+}
+
+void print_input_latency(const struct input_latency* latency)
+{
+    if (latency->count == 0)
+        return;
+
+    fprintf(stdout,
+            GREEN_2 "input to present: %" PRIu64 " key events, mean %.1fms, 50%% under %dms, 99%% under %dms, "
+                    "worst %.1fms\n" RESET,
+            latency->count, latency->total_ns / 1e6 / latency->count, latency_percentile(latency, 0.5),
+            latency_percentile(latency, 0.99), latency->max_ns / 1e6);
+}
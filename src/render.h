@@ -0,0 +1,52 @@
+#ifndef REBORN_RENDER_H
+#define REBORN_RENDER_H
+
+#include "chip.h"
+
+/**
+ * Presentation thread.
+ **
+ * The emulator thread never blocks on the renderer: it copies the display
+ * into the free slot of a triple buffer and swaps it with the middle slot in
+ * one atomic exchange. The render thread swaps the middle slot with the one
+ * it presents from whenever a new frame has been published, so it always
+ * shows the newest complete frame and frames it was too slow for are dropped.
+ *
+ * A frame can carry the host time of the oldest key event it is the first to
+ * show the effect of, which is the first frame presented after the event. The
+ * render thread takes the time from then to the end of SDL_RenderPresent() as
+ * the input to present latency of that event.
+ **/
+
+enum {
+    /* 1ms each, the last one also takes everything longer */
+    LATENCY_BUCKETS = 100,
+};
+
+struct input_latency {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LATENCY_BUCKETS];
+};
+
+/* creates the renderer for sdl_objs->screen on a new thread and starts
+ * presenting published frames with the fg and bg colors, returns NULL when
+ * the thread cannot be created */
+struct render* render_start(struct sdl_objs* sdl_objs, uint32_t fg, uint32_t bg);
+
+/* hands a copy of the display to the render thread, with the time of the
+ * oldest key event not shown yet or 0. returns the time of the frame this one
+ * replaced before it was presented, which the next frame has to carry, or 0 */
+uint64_t render_publish(struct render* r, const uint64_t display[DISPH], uint64_t input_ns);
+
+/* stops and joins the render thread, which destroys its renderer, copies
+ * the latencies measured to latency when it is not NULL and returns the
+ * number of frames it presented */
+uint64_t render_stop(struct render* r, struct input_latency* latency);
+
+/* prints the number of key events presented, their mean and worst latency
+ * and the 50th and 99th percentiles, to the millisecond */
+void print_input_latency(const struct input_latency* latency);
+
+#endif
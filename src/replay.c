@@ -0,0 +1,177 @@
+#include "replay.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char replay_magic[8] = "C8RBINPT";
+
+enum { REPLAY_VERSION = 1 };
+
+struct replay_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t quirks;
+    uint64_t seed;
+    uint64_t frequency;
+    uint64_t rom_hash;
+};
+
+struct replay_event {
+    uint64_t cycle;
+    uint16_t keys;
+    /* set on the last event, written when the recording ends */
+    uint16_t end;
+    uint32_t reserved;
+};
+
+struct replay {
+    FILE* fp;
+    struct replay_header header;
+    uint16_t keys;
+    Bool recording;
+
+    /* the events of a replay, all read in up front */
+    struct replay_event* events;
+    size_t event_count;
+    size_t next;
+};
+
+static uint64_t rom_hash(const struct state* s)
+{
+    uint64_t hash = 0xcbf29ce484222325u;
+
+    for (int i = 0; i < s->rom_size; i++)
+        hash = (hash ^ s->chip8->memory[PROGRAM_LOAD_ADDRESS + i]) * 0x100000001b3u;
+
+    return hash;
+}
+
+struct replay* replay_record_open(const char* path, const struct state* s)
+{
+    struct replay* r = calloc(1, sizeof(*r));
+
+    if (r == NULL)
+        return NULL;
+
+    r->fp = fopen(path, "wb");
+    if (r->fp == NULL) {
+        free(r);
+        return NULL;
+    }
+
+    memcpy(r->header.magic, replay_magic, sizeof(r->header.magic));
+    r->header.version = REPLAY_VERSION;
+    r->header.quirks = s->data->quirks;
+    r->header.seed = s->data->seed;
+    r->header.frequency = s->data->frequency;
+    r->header.rom_hash = rom_hash(s);
+    r->recording = TRUE;
+
+    fwrite(&r->header, sizeof(r->header), 1, r->fp);
+
+    /* the keypad the run starts with is the first event */
+    r->keys = ~s->keys;
+    replay_record(r, s);
+
+    return r;
+}
+
+void replay_record(struct replay* r, const struct state* s)
+{
+    if (s->keys == r->keys)
+        return;
+
+    struct replay_event event = {.cycle = s->cycles, .keys = s->keys};
+    fwrite(&event, sizeof(event), 1, r->fp);
+    r->keys = s->keys;
+}
+
+struct replay* replay_open(const char* path, struct chip8_launch_data* data)
+{
+    struct replay* r = calloc(1, sizeof(*r));
+
+    if (r == NULL)
+        return NULL;
+
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        free(r);
+        return NULL;
+    }
+
+    if (fread(&r->header, sizeof(r->header), 1, fp) != 1 ||
+        memcmp(r->header.magic, replay_magic, sizeof(r->header.magic)) != 0 || r->header.version != REPLAY_VERSION)
+        goto invalid;
+
+    /* the rest of the file is events */
+    long start = ftell(fp);
+    if (fseek(fp, 0L, SEEK_END) != 0)
+        goto invalid;
+
+    long end = ftell(fp);
+    if (end < start || (end - start) % sizeof(struct replay_event) != 0 || fseek(fp, start, SEEK_SET) != 0)
+        goto invalid;
+
+    r->event_count = (end - start) / sizeof(struct replay_event);
+    r->events = malloc(r->event_count * sizeof(*r->events) + 1);
+
+    if (r->events == NULL || fread(r->events, sizeof(*r->events), r->event_count, fp) != r->event_count)
+        goto invalid;
+
+    fclose(fp);
+
+    data->seed = r->header.seed;
+    data->yes_seed = TRUE;
+    data->frequency = r->header.frequency;
+    data->quirks = r->header.quirks;
+    data->headless = TRUE;
+
+    /* a recording that was ended properly knows how long the run was */
+    if (r->event_count && r->events[r->event_count - 1].end && !data->cycle_limit && !data->frame_limit)
+        data->cycle_limit = r->events[r->event_count - 1].cycle;
+
+    return r;
+
+invalid:
+    fclose(fp);
+    free(r->events);
+    free(r);
+    errno = EINVAL;
+    return NULL;
+}
+
+Bool replay_matches_rom(const struct replay* r, const struct state* s)
+{
+    return r->header.rom_hash == rom_hash(s);
+}
+
+void replay_feed(struct replay* r, struct state* s)
+{
+    while (r->next < r->event_count && r->events[r->next].cycle <= s->cycles) {
+        s->keys = r->events[r->next++].keys;
+    }
+}
+
+int replay_close(struct replay* r, const struct state* s)
+{
+    if (r == NULL)
+        return 0;
+
+    int ret = 0;
+
+    if (r->recording) {
+        struct replay_event event = {.cycle = s->cycles, .keys = r->keys, .end = TRUE};
+        fwrite(&event, sizeof(event), 1, r->fp);
+
+        Bool failed = ferror(r->fp);
+
+        if (fclose(r->fp) != 0 || failed)
+            ret = BAD_RETURN_VALUE;
+    }
+
+    free(r->events);
+    free(r);
+    return ret;
+}
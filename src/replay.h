@@ -0,0 +1,40 @@
+#ifndef REBORN_REPLAY_H
+#define REBORN_REPLAY_H
+
+#include "libchip8.h"
+
+/**
+ * Input recording and replay.
+ **
+ * A recording is a header with everything besides the input that decides how
+ * a run goes (the seed, the frequency, the quirks and a hash of the ROM)
+ * followed by the keypad as a 16 bit mask every time it changed, stamped with
+ * the number of instructions executed by then. Input is only ever read in
+ * between frames, so feeding the masks back in at the same instruction
+ * counts repeats the run exactly, however fast it is replayed.
+ **/
+
+/* creates the recording at path for the instance, returns NULL with errno
+ * set when the file cannot be written */
+struct replay* replay_record_open(const char* path, const struct state* s);
+
+/* records the keypad when it changed since the last call */
+void replay_record(struct replay* r, const struct state* s);
+
+/* opens a recording and sets up data to run it the way it was recorded,
+ * headless and until the instruction count it ended at. returns NULL with
+ * errno set when the file cannot be read or is not a recording */
+struct replay* replay_open(const char* path, struct chip8_launch_data* data);
+
+/* returns FALSE when the ROM loaded into the instance is not the one
+ * the recording was made with */
+Bool replay_matches_rom(const struct replay* r, const struct state* s);
+
+/* sets the keypad to what it was at this point of the recording */
+void replay_feed(struct replay* r, struct state* s);
+
+/* ends a recording and closes it, or closes a replay, returns
+ * BAD_RETURN_VALUE when the recording could not be written completely */
+int replay_close(struct replay* r, const struct state* s);
+
+#endif
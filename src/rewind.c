@@ -0,0 +1,230 @@
+#include "rewind.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    /* runs of at least this many unchanged bytes end a literal, shorter ones
+     * cost less as part of it than a new run header */
+    MIN_SKIP = 4,
+    /* an entry holds about this many bytes at least, sizes the entry table */
+    MIN_ENTRY_SIZE = 32,
+    KEYFRAME_BIT = 1u << 31,
+};
+
+static_assert(sizeof(struct chip8_savestate) <= UINT16_MAX, "run lengths are stored in 16 bits");
+
+struct rewind_entry {
+    uint32_t offset;
+    /* size in bytes, KEYFRAME_BIT is set for keyframes */
+    uint32_t size;
+};
+
+struct rewind {
+    uint8_t* data;
+    size_t data_size;
+
+    struct rewind_entry* entries;
+    size_t entry_capacity;
+    size_t first;
+    size_t count;
+
+    unsigned int keyframe_interval;
+    unsigned int since_keyframe;
+
+    /* the state of the newest entry, deltas are taken against it */
+    struct chip8_savestate last;
+    struct chip8_savestate zero;
+
+    /* one encoded state at its worst, every other byte changed */
+    uint8_t scratch[3 * sizeof(struct chip8_savestate)];
+};
+
+/* encodes cur XOR prev as runs of a 16 bit count of unchanged bytes, a 16 bit
+ * count of changed bytes and the changed bytes XORed, unchanged bytes at the
+ * end are left out. returns the number of bytes written to out */
+static size_t xor_rle_encode(const uint8_t* cur, const uint8_t* prev, size_t size, uint8_t* out)
+{
+    size_t in = 0, o = 0;
+
+    while (in < size) {
+        size_t skip_start = in;
+        while (in < size && cur[in] == prev[in])
+            in++;
+
+        if (in == size)
+            break;
+
+        size_t literal_start = in;
+        while (in < size) {
+            size_t same = 0;
+            while (in + same < size && cur[in + same] == prev[in + same])
+                same++;
+
+            if (same >= MIN_SKIP || in + same == size)
+                break;
+            in += same ? same : 1;
+        }
+
+        uint16_t skip = literal_start - skip_start;
+        uint16_t literal = in - literal_start;
+        memcpy(&out[o], &skip, sizeof(skip));
+        memcpy(&out[o + 2], &literal, sizeof(literal));
+        o += 4;
+
+        for (size_t i = literal_start; i < in; i++)
+            out[o++] = cur[i] ^ prev[i];
+    }
+
+    return o;
+}
+
+/* XORs an encoded delta into state */
+static void xor_rle_apply(uint8_t* state, const uint8_t* in, size_t size)
+{
+    size_t pos = 0;
+
+    for (size_t i = 0; i < size;) {
+        uint16_t skip, literal;
+        memcpy(&skip, &in[i], sizeof(skip));
+        memcpy(&literal, &in[i + 2], sizeof(literal));
+        i += 4;
+        pos += skip;
+
+        for (uint16_t k = 0; k < literal; k++)
+            state[pos++] ^= in[i++];
+    }
+}
+
+static inline struct rewind_entry* entry(const struct rewind* r, size_t n)
+{
+    return &r->entries[(r->first + n) % r->entry_capacity];
+}
+
+/* drops the oldest keyframe and the deltas that follow it */
+static void drop_oldest(struct rewind* r)
+{
+    do {
+        r->first = (r->first + 1) % r->entry_capacity;
+        r->count--;
+    } while (r->count && !(entry(r, 0)->size & KEYFRAME_BIT));
+}
+
+/* finds size free bytes after the newest entry, dropping old ones as needed */
+static uint8_t* reserve(struct rewind* r, size_t size)
+{
+    for (;;) {
+        if (r->count == 0)
+            return r->data;
+
+        if (r->count < r->entry_capacity) {
+            const struct rewind_entry* oldest = entry(r, 0);
+            const struct rewind_entry* newest = entry(r, r->count - 1);
+            size_t end = newest->offset + (newest->size & ~KEYFRAME_BIT);
+
+            if (newest->offset >= oldest->offset) {
+                /* free space after the newest entry and before the oldest */
+                if (r->data_size - end >= size)
+                    return &r->data[end];
+                if (oldest->offset >= size)
+                    return r->data;
+            } else if (oldest->offset - end >= size) {
+                return &r->data[end];
+            }
+        }
+
+        drop_oldest(r);
+    }
+}
+
+struct rewind* rewind_create(size_t size, unsigned int keyframe_interval)
+{
+    struct rewind* r = calloc(1, sizeof(*r));
+
+    if (r == NULL)
+        return NULL;
+
+    r->data_size = size;
+    r->data = malloc(size);
+    r->entry_capacity = size / MIN_ENTRY_SIZE + 1;
+    r->entries = malloc(r->entry_capacity * sizeof(*r->entries));
+    r->keyframe_interval = keyframe_interval ? keyframe_interval : 1;
+
+    if (r->data == NULL || r->entries == NULL || size < sizeof(r->scratch)) {
+        rewind_destroy(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+void rewind_destroy(struct rewind* r)
+{
+    if (r == NULL)
+        return;
+
+    free(r->data);
+    free(r->entries);
+    free(r);
+}
+
+void rewind_push(struct rewind* r, const struct state* s)
+{
+    struct chip8_savestate cur;
+    chip8_save_state(s, &cur);
+
+    Bool keyframe = r->count == 0 || r->since_keyframe + 1 >= r->keyframe_interval;
+    const struct chip8_savestate* base = keyframe ? &r->zero : &r->last;
+
+    size_t size = xor_rle_encode((const uint8_t*)&cur, (const uint8_t*)base, sizeof(cur), r->scratch);
+    uint8_t* dst = reserve(r, size);
+
+    /* dropping old entries may have taken the keyframe this delta needs */
+    if (!keyframe && r->count == 0) {
+        keyframe = TRUE;
+        size = xor_rle_encode((const uint8_t*)&cur, (const uint8_t*)&r->zero, sizeof(cur), r->scratch);
+        dst = reserve(r, size);
+    }
+
+    memcpy(dst, r->scratch, size);
+    *entry(r, r->count) = (struct rewind_entry){.offset = dst - r->data, .size = size | (keyframe ? KEYFRAME_BIT : 0)};
+    r->count++;
+
+    r->since_keyframe = keyframe ? 0 : r->since_keyframe + 1;
+    r->last = cur;
+}
+
+int rewind_step_back(struct rewind* r, struct state* s)
+{
+    if (r->count < 2)
+        return BAD_RETURN_VALUE;
+
+    r->count--;
+
+    /* rebuild the new newest state from the keyframe it depends on */
+    size_t key = r->count - 1;
+    while (!(entry(r, key)->size & KEYFRAME_BIT))
+        key--;
+
+    memset(&r->last, 0, sizeof(r->last));
+    for (size_t n = key; n < r->count; n++) {
+        const struct rewind_entry* e = entry(r, n);
+        xor_rle_apply((uint8_t*)&r->last, &r->data[e->offset], e->size & ~KEYFRAME_BIT);
+    }
+
+    r->since_keyframe = r->count - 1 - key;
+    return chip8_load_state(s, &r->last);
+}
+
+void rewind_print_stats(const struct rewind* r)
+{
+    size_t bytes = 0;
+    for (size_t n = 0; n < r->count; n++)
+        bytes += entry(r, n)->size & ~KEYFRAME_BIT;
+
+    fprintf(stdout, GREEN_2 "rewind: %zu frames (%.1fs) held in %zu bytes, %.1f bytes per frame\n" RESET, r->count,
+            (double)r->count / FRAME_RATE, bytes, r->count ? (double)bytes / r->count : 0);
+}
@@ -0,0 +1,33 @@
+#ifndef REBORN_REWIND_H
+#define REBORN_REWIND_H
+
+#include "libchip8.h"
+
+/**
+ * Rewind history.
+ **
+ * After every frame the save state of the instance is XORed with the one of
+ * the frame before and the result is run length encoded, which leaves only
+ * the few bytes the frame changed. Every keyframe_interval frames the state
+ * is stored whole (encoded against zeros) instead. Entries go into a ring of
+ * a fixed number of bytes; when it is full the oldest keyframe is dropped
+ * together with the deltas that depend on it.
+ **/
+
+/* allocates a history of size bytes, returns NULL when out of memory */
+struct rewind* rewind_create(size_t size, unsigned int keyframe_interval);
+
+/* frees the history */
+void rewind_destroy(struct rewind* r);
+
+/* records the state the instance is in after a frame */
+void rewind_push(struct rewind* r, const struct state* s);
+
+/* puts the instance back to the frame before the last one recorded and
+ * forgets the last one. returns BAD_RETURN_VALUE when there is nothing older */
+int rewind_step_back(struct rewind* r, struct state* s);
+
+/* prints how many frames are held and in how many bytes to stdout */
+void rewind_print_stats(const struct rewind* r);
+
+#endif
@@ -0,0 +1,122 @@
+#include "libchip8.h"
+#include "chip_instructions.h"
+#include "watchdog.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char state_magic[8] = "C8RBSAVE";
+
+void chip8_save_state(const struct state* s, struct chip8_savestate* out)
+{
+    /* padding included, so that the same machine always gives the same bytes */
+    memset(out, 0, sizeof(*out));
+
+    memcpy(out->magic, state_magic, sizeof(out->magic));
+    out->version = CHIP8_STATE_VERSION;
+    out->size = sizeof(*out);
+    out->chip8 = *s->chip8;
+    out->keys = s->keys;
+    out->budget_carry = s->budget_carry;
+    out->cycles = s->cycles;
+    out->frames = s->frames;
+}
+
+int chip8_load_state(struct state* s, const struct chip8_savestate* in)
+{
+    if (memcmp(in->magic, state_magic, sizeof(in->magic)) != 0 || in->version != CHIP8_STATE_VERSION ||
+        in->size != sizeof(*in)) {
+        errno = EINVAL;
+        return BAD_RETURN_VALUE;
+    }
+
+    /* only the runs of memory that differ are written through the decode
+     * cache invalidation, so a state of the same ROM keeps its native code */
+    for (int addr = 0; addr < MEMSIZE;) {
+        if (s->chip8->memory[addr] == in->chip8.memory[addr]) {
+            addr++;
+            continue;
+        }
+
+        int end = addr + 1;
+        while (end < MEMSIZE && s->chip8->memory[end] != in->chip8.memory[end])
+            end++;
+
+        memcpy(&s->chip8->memory[addr], &in->chip8.memory[addr], end - addr);
+        invalidate_decoded(s, addr, end - addr);
+        addr = end;
+    }
+
+    *s->chip8 = in->chip8;
+    s->keys = in->keys;
+    s->budget_carry = in->budget_carry;
+    s->frame_left = 0;
+    s->cycles = in->cycles;
+    s->frames = in->frames;
+
+    if (s->watchdog)
+        watchdog_reset(s->watchdog, s);
+
+    /* the whole display has to be presented again */
+    s->dirty_rows = UINT32_MAX;
+    s->DrawFL = TRUE;
+
+    return 0;
+}
+
+int chip8_write_state(const struct state* s, const char* path)
+{
+    struct chip8_savestate st;
+    chip8_save_state(s, &st);
+
+    /* written next to the target and renamed over it, so that a failed write
+     * never destroys the previous save */
+    size_t len = strlen(path);
+    char* tmp_path = malloc(len + sizeof(".tmp"));
+
+    if (tmp_path == NULL)
+        return BAD_RETURN_VALUE;
+
+    memcpy(tmp_path, path, len);
+    memcpy(tmp_path + len, ".tmp", sizeof(".tmp"));
+
+    FILE* fp = fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        free(tmp_path);
+        return BAD_RETURN_VALUE;
+    }
+
+    Bool written = fwrite(&st, sizeof(st), 1, fp) == 1;
+
+    if (fclose(fp) != 0 || !written || rename(tmp_path, path) != 0) {
+        int error = errno;
+        remove(tmp_path);
+        free(tmp_path);
+        errno = error ? error : EIO;
+        return BAD_RETURN_VALUE;
+    }
+
+    free(tmp_path);
+    return 0;
+}
+
+int chip8_read_state(struct state* s, const char* path)
+{
+    struct chip8_savestate st;
+
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return BAD_RETURN_VALUE;
+
+    Bool read = fread(&st, sizeof(st), 1, fp) == 1;
+    fclose(fp);
+
+    if (!read) {
+        errno = EINVAL;
+        return BAD_RETURN_VALUE;
+    }
+
+    return chip8_load_state(s, &st);
+}
@@ -0,0 +1,228 @@
+#define _DEFAULT_SOURCE
+
+#include "trace.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __unix__
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <threads.h>
+#include <unistd.h>
+
+enum {
+    /* the file is grown and mapped this many bytes at a time, a multiple of
+     * both the page size and the record size */
+    TRACE_CHUNK_SIZE = 16 << 20,
+    /* how long the flush thread sleeps when the ring is empty */
+    TRACE_FLUSH_INTERVAL_NS = 1000000,
+};
+
+static const char trace_magic[8] = "C8RBTRCE";
+
+static_assert(sizeof(struct trace_header) == sizeof(struct trace_record), "records start on a record boundary");
+static_assert(TRACE_CHUNK_SIZE % sizeof(struct trace_record) == 0, "records never cross a chunk");
+
+struct trace_internal {
+    int fd;
+    thrd_t thread;
+    atomic_bool stop;
+
+    /* the chunk of the file that is mapped, and where in the file the next
+     * record goes */
+    uint8_t* map;
+    size_t map_chunk;
+    size_t offset;
+
+    Bool failed;
+};
+
+/* maps the chunk of the file that holds offset, growing the file to fit it */
+static int map_chunk(struct trace_internal* in)
+{
+    size_t chunk = in->offset / TRACE_CHUNK_SIZE;
+
+    if (in->map && in->map_chunk == chunk)
+        return 0;
+
+    if (in->map)
+        munmap(in->map, TRACE_CHUNK_SIZE);
+    in->map = NULL;
+
+    if (ftruncate(in->fd, (off_t)(chunk + 1) * TRACE_CHUNK_SIZE) != 0)
+        return BAD_RETURN_VALUE;
+
+    void* map = mmap(NULL, TRACE_CHUNK_SIZE, PROT_WRITE, MAP_SHARED, in->fd, (off_t)chunk * TRACE_CHUNK_SIZE);
+    if (map == MAP_FAILED)
+        return BAD_RETURN_VALUE;
+
+    in->map = map;
+    in->map_chunk = chunk;
+    return 0;
+}
+
+/* copies count records to the end of the file. once writing has failed the
+ * records are dropped, so that the emulator is never held up */
+static void write_records(struct trace_internal* in, const struct trace_record* records, size_t count)
+{
+    while (count && !in->failed) {
+        if (map_chunk(in) == BAD_RETURN_VALUE) {
+            in->failed = TRUE;
+            return;
+        }
+
+        size_t at = in->offset % TRACE_CHUNK_SIZE;
+        size_t n = (TRACE_CHUNK_SIZE - at) / sizeof(*records);
+        if (n > count)
+            n = count;
+
+        memcpy(in->map + at, records, n * sizeof(*records));
+        in->offset += n * sizeof(*records);
+        records += n;
+        count -= n;
+    }
+}
+
+static int flush_main(void* arg)
+{
+    struct trace* t = arg;
+    struct trace_internal* in = t->internal;
+    size_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+
+    for (;;) {
+        /* stop is read before head, so the last head seen after stopping
+         * includes every record */
+        Bool stopping = atomic_load_explicit(&in->stop, memory_order_acquire);
+        size_t head = atomic_load_explicit(&t->head, memory_order_acquire);
+
+        if (head == tail) {
+            if (stopping)
+                return 0;
+
+            thrd_sleep(&(struct timespec){.tv_nsec = TRACE_FLUSH_INTERVAL_NS}, NULL);
+            continue;
+        }
+
+        /* the records up to the end of the ring, the rest on the next round */
+        size_t first = tail & (TRACE_RING_SIZE - 1);
+        size_t count = head - tail;
+        if (count > TRACE_RING_SIZE - first)
+            count = TRACE_RING_SIZE - first;
+
+        write_records(in, &t->ring[first], count);
+
+        tail += count;
+        atomic_store_explicit(&t->tail, tail, memory_order_release);
+    }
+}
+
+struct trace* trace_open(const char* path)
+{
+    struct trace* t = aligned_alloc(_Alignof(struct trace), sizeof(struct trace));
+    struct trace_internal* in = calloc(1, sizeof(*in));
+
+    if (t == NULL || in == NULL) {
+        free(t);
+        free(in);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    atomic_init(&t->head, 0);
+    atomic_init(&t->tail, 0);
+    atomic_init(&in->stop, FALSE);
+    t->tail_seen = 0;
+    t->internal = in;
+
+    in->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (in->fd < 0)
+        goto fail;
+
+    struct trace_header header = {.version = TRACE_VERSION, .record_size = sizeof(struct trace_record)};
+    memcpy(header.magic, trace_magic, sizeof(header.magic));
+
+    if (write(in->fd, &header, sizeof(header)) != sizeof(header))
+        goto fail_close;
+    in->offset = sizeof(header);
+
+    if (thrd_create(&in->thread, flush_main, t) != thrd_success) {
+        errno = EAGAIN;
+        goto fail_close;
+    }
+
+    return t;
+
+fail_close:
+    close(in->fd);
+fail:
+    free(in);
+    free(t);
+    return NULL;
+}
+
+int trace_close(struct trace* t)
+{
+    if (t == NULL)
+        return 0;
+
+    struct trace_internal* in = t->internal;
+
+    atomic_store_explicit(&in->stop, TRUE, memory_order_release);
+    thrd_join(in->thread, NULL);
+
+    if (in->map)
+        munmap(in->map, TRACE_CHUNK_SIZE);
+
+    /* the file was grown a chunk at a time, cut it back to the last record */
+    if (ftruncate(in->fd, in->offset) != 0)
+        in->failed = TRUE;
+
+    if (close(in->fd) != 0)
+        in->failed = TRUE;
+
+    int ret = in->failed ? BAD_RETURN_VALUE : 0;
+
+    free(in);
+    free(t);
+    return ret;
+}
+
+void trace_wait(struct trace* t)
+{
+    size_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+
+    for (;;) {
+        t->tail_seen = atomic_load_explicit(&t->tail, memory_order_acquire);
+
+        if (head - t->tail_seen < TRACE_RING_SIZE)
+            return;
+
+        thrd_yield();
+    }
+}
+
+#else
+
+struct trace* trace_open(const char* path)
+{
+    (void)path;
+    errno = ENOSYS;
+    return NULL;
+}
+
+int trace_close(struct trace* t)
+{
+    (void)t;
+    return 0;
+}
+
+void trace_wait(struct trace* t)
+{
+    (void)t;
+}
+
+#endif
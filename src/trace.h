@@ -0,0 +1,84 @@
+#ifndef REBORN_TRACE_H
+#define REBORN_TRACE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include "chip.h"
+
+/**
+ * Binary execution trace.
+ **
+ * While s->trace is set chip8_run_frame() runs the switch core and appends a
+ * fixed size record for every instruction to a ring owned by the instance,
+ * so only the thread running the instance ever writes to it. A thread of the
+ * trace's own copies the ring into the trace file through a memory mapping,
+ * the emulator only waits for it when the ring is full.
+ *
+ * The file is a trace_header followed by one trace_record per instruction in
+ * the order they ran, decoded by the chip8-trace tool.
+ **/
+
+enum {
+    TRACE_VERSION = 1,
+    /* records in the ring, a power of 2 */
+    TRACE_RING_SIZE = 1 << 18,
+};
+
+struct trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+/* one executed instruction and what it left behind. changed has a bit set for
+ * every register the instruction wrote a new value to, the values of VX and
+ * VF are kept, the other registers an FX65 loads are only marked */
+struct trace_record {
+    uint16_t pc;
+    uint16_t opcode;
+    uint16_t index;
+    uint16_t changed;
+    uint8_t vx;
+    uint8_t vf;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint32_t frame;
+};
+
+struct trace {
+    /* written by the emulator thread only */
+    _Alignas(64) atomic_size_t head;
+    size_t tail_seen;
+
+    /* written by the flush thread only */
+    _Alignas(64) atomic_size_t tail;
+
+    _Alignas(64) struct trace_record ring[TRACE_RING_SIZE];
+    struct trace_internal* internal;
+};
+
+/* creates the trace file at path and starts the thread writing to it.
+ * returns NULL with errno set when the file or the thread cannot be created */
+struct trace* trace_open(const char* path);
+
+/* writes what is left in the ring, stops the thread and closes the file.
+ * returns BAD_RETURN_VALUE when not all of the trace could be written */
+int trace_close(struct trace* t);
+
+/* waits for the flush thread to make room in a full ring */
+void trace_wait(struct trace* t);
+
+/* adds a record to the ring */
+[[gnu::always_inline]] static inline void trace_append(struct trace* t, const struct trace_record* r)
+{
+    size_t head = atomic_load_explicit(&t->head, memory_order_relaxed);
+
+    /* the tail is read again only when the ring looks full */
+    if (head - t->tail_seen == TRACE_RING_SIZE)
+        trace_wait(t);
+
+    t->ring[head & (TRACE_RING_SIZE - 1)] = *r;
+    atomic_store_explicit(&t->head, head + 1, memory_order_release);
+}
+
+#endif
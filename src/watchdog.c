@@ -0,0 +1,88 @@
+#include "watchdog.h"
+#include "helpers.h"
+
+#include <string.h>
+
+[[gnu::always_inline]] static inline uint64_t mix(uint64_t hash, uint64_t word)
+{
+    return (hash ^ word) * 0x100000001b3u;
+}
+
+/* FNV-1a a word at a time over everything but memory */
+static uint64_t hash_machine(const struct state* s)
+{
+    const struct chip8_sys* chip8 = s->chip8;
+    uint64_t words[REGNUM / 8];
+    uint64_t stack[STACKSIZE / 4];
+    uint64_t hash = hash_display(chip8->display);
+
+    memcpy(words, chip8->registers, sizeof(words));
+    for (size_t i = 0; i < sizeof(words) / sizeof(*words); i++)
+        hash = mix(hash, words[i]);
+
+    memcpy(stack, chip8->stack, sizeof(stack));
+    for (size_t i = 0; i < sizeof(stack) / sizeof(*stack); i++)
+        hash = mix(hash, stack[i]);
+
+    hash = mix(hash, (uint64_t)chip8->index | (uint64_t)chip8->program_counter << 16 |
+                         (uint64_t)chip8->delay_timer << 32 | (uint64_t)chip8->sound_timer << 40 |
+                         (uint64_t)chip8->stacktop << 48);
+    hash = mix(hash, chip8->rng);
+    hash = mix(hash, s->keys);
+
+    return mix(hash, s->budget_carry);
+}
+
+/* true when s is exactly the machine copied when the loop was suspected */
+static Bool same_machine(const struct watchdog* w, const struct state* s)
+{
+    return memcmp(&w->machine, s->chip8, sizeof(w->machine)) == 0 && w->keys == s->keys &&
+           w->budget_carry == s->budget_carry;
+}
+
+void watchdog_reset(struct watchdog* w, const struct state* s)
+{
+    memset(w, 0, sizeof(*w));
+    w->next = s->cycles + WATCHDOG_INTERVAL;
+}
+
+void watchdog_sample(struct watchdog* w, struct state* s)
+{
+    uint64_t hash = hash_machine(s);
+
+    w->next = s->cycles + WATCHDOG_INTERVAL;
+
+    if (w->confirm_at && w->samples == w->confirm_at) {
+        if (same_machine(w, s)) {
+            w->halted = TRUE;
+            w->halt_pc = w->machine.program_counter;
+            w->halt_cycles = w->confirm_cycles;
+            s->run = FALSE;
+            return;
+        }
+
+        w->confirm_at = 0;
+    }
+
+    /* the most recent match is the shortest loop, which is confirmed soonest */
+    if (!w->confirm_at) {
+        uint64_t seen = w->samples < WATCHDOG_HISTORY ? w->samples : WATCHDOG_HISTORY;
+
+        for (uint64_t back = 1; back <= seen; back++) {
+            size_t slot = (w->samples - back) % WATCHDOG_HISTORY;
+
+            if (w->hashes[slot] != hash)
+                continue;
+
+            w->confirm_at = w->samples + back;
+            w->confirm_cycles = s->cycles;
+            w->machine = *s->chip8;
+            w->keys = s->keys;
+            w->budget_carry = s->budget_carry;
+            break;
+        }
+    }
+
+    w->hashes[w->samples % WATCHDOG_HISTORY] = hash;
+    w->samples++;
+}
@@ -0,0 +1,57 @@
+#ifndef REBORN_WATCHDOG_H
+#define REBORN_WATCHDOG_H
+
+#include "chip.h"
+
+/**
+ * The --watchdog, which ends headless runs that only repeat themselves.
+ **
+ * Every WATCHDOG_INTERVAL instructions, at the end of a frame, the registers,
+ * I, the PC, the stack, the timers, the display, the keypad and the frame
+ * scheduler are hashed into one word, which is looked up among the hashes of
+ * the last WATCHDOG_HISTORY samples. Memory is left out of the hash, so a
+ * match is only a suspect: the whole machine is copied, and when it is exactly
+ * the same again the same number of samples later, the run can only go round
+ * that loop for ever. Nothing but the machine feeds into a headless instance,
+ * so chip8_run_frame() then clears s->run.
+ *
+ * A sample costs a hash of about 50 words and a scan of the history, which is
+ * lost in the instructions between two samples. Loops that take longer than
+ * WATCHDOG_HISTORY samples to come round are not noticed.
+ **/
+
+enum {
+    WATCHDOG_INTERVAL = 1 << 16,
+    WATCHDOG_HISTORY = 64,
+};
+
+struct watchdog {
+    /* the cycle count at which the next sample is taken */
+    uint64_t next;
+    uint64_t samples;
+    uint64_t hashes[WATCHDOG_HISTORY];
+
+    /* a suspected loop, confirmed or dropped at sample number confirm_at,
+     * 0 when there is none, with the machine and the cycle count of the
+     * sample it was suspected at */
+    uint64_t confirm_at;
+    uint64_t confirm_cycles;
+    struct chip8_sys machine;
+    uint16_t keys;
+    unsigned long budget_carry;
+
+    /* set once a loop was confirmed, with where the machine was in it */
+    Bool halted;
+    uint16_t halt_pc;
+    uint64_t halt_cycles;
+};
+
+/* forgets every sample, the next one is taken WATCHDOG_INTERVAL
+ * instructions after the current cycle count of s */
+void watchdog_reset(struct watchdog* w, const struct state* s);
+
+/* takes a sample of s at the end of a frame, sets halted and clears s->run
+ * when s went round a loop that can not end */
+void watchdog_sample(struct watchdog* w, struct state* s);
+
+#endif
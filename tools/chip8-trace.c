@@ -0,0 +1,208 @@
+/* chip8-trace, prints and filters the traces written by chip8-rb --trace.
+ *
+ * every record that passes all of the filters given is printed as
+ *
+ *   instruction frame  PC    opcode  assembly   I DT ST  registers written
+ *
+ * with --summary only the number of records that passed and the instruction
+ * mix among them are printed instead.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "../src/disasm.h"
+#include "../src/trace.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+enum { RECORDS_PER_READ = 4096 };
+
+struct filter {
+    uint64_t from;
+    uint64_t to;
+    uint16_t pc_first;
+    uint16_t pc_last;
+    /* an instruction_names index, INST_UNDECODED when any instruction passes */
+    uint8_t instruction;
+    /* a mask of registers of which at least one has to be written */
+    uint16_t registers;
+    Bool summary;
+};
+
+static void print_usage(void)
+{
+    fprintf(stderr,
+            "usage: chip8-trace FILE [options]\n"
+            "  --from N           Skip the instructions before the Nth, counting from 0\n"
+            "  --to N             Stop after the Nth instruction\n"
+            "  --pc ADDR[-ADDR]   Only instructions at ADDR, or between the two addresses\n"
+            "  --inst NAME        Only one instruction, named by its pattern as in DXYN or 8XY4\n"
+            "  --reg X            Only instructions that wrote register VX, X in hex\n"
+            "  --summary          Print the number of instructions and the instruction mix only\n");
+    exit(2);
+}
+
+static uint64_t parse_number(const char* s, int base)
+{
+    char* end;
+    errno = 0;
+    uint64_t n = strtoull(s, &end, base);
+
+    if (errno || end == s || *end != '\0') {
+        fprintf(stderr, "chip8-trace: bad number '%s'\n", s);
+        exit(2);
+    }
+
+    return n;
+}
+
+static void parse_args(int argc, char** argv, struct filter* f)
+{
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--summary") == 0) {
+            f->summary = TRUE;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            print_usage();
+
+        const char* value = argv[++i];
+
+        if (strcmp(argv[i - 1], "--from") == 0) {
+            f->from = parse_number(value, BASE_10);
+
+        } else if (strcmp(argv[i - 1], "--to") == 0) {
+            f->to = parse_number(value, BASE_10);
+
+        } else if (strcmp(argv[i - 1], "--pc") == 0) {
+            char first[16];
+            const char* dash = strchr(value, '-');
+            size_t len = dash ? (size_t)(dash - value) : strlen(value);
+
+            snprintf(first, sizeof(first), "%.*s", (int)len, value);
+            f->pc_first = parse_number(first, BASE_16);
+            f->pc_last = dash ? parse_number(dash + 1, BASE_16) : f->pc_first;
+
+        } else if (strcmp(argv[i - 1], "--inst") == 0) {
+            f->instruction = INST_UNDECODED + 1;
+            while (f->instruction <= INST_UNKNOWN && strcasecmp(instruction_names[f->instruction], value) != 0)
+                f->instruction++;
+
+            if (f->instruction > INST_UNKNOWN) {
+                fprintf(stderr, "chip8-trace: unknown instruction '%s'\n", value);
+                exit(2);
+            }
+
+        } else if (strcmp(argv[i - 1], "--reg") == 0) {
+            f->registers |= 1u << (parse_number(value, BASE_16) & 0xF);
+
+        } else {
+            print_usage();
+        }
+    }
+}
+
+static Bool passes(const struct filter* f, const struct trace_record* r, uint8_t handler)
+{
+    if (r->pc < f->pc_first || r->pc > f->pc_last)
+        return FALSE;
+
+    if (f->instruction != INST_UNDECODED && handler != f->instruction)
+        return FALSE;
+
+    if (f->registers && !(r->changed & f->registers))
+        return FALSE;
+
+    return TRUE;
+}
+
+static void print_record(uint64_t n, const struct trace_record* r, uint8_t x)
+{
+    char text[32];
+    disassemble(r->opcode, text, sizeof(text));
+
+    fprintf(stdout, "%12" PRIu64 " %8" PRIu32 "  0x%03X  %04X  %-16s I=%03X DT=%02X ST=%02X ", n, r->frame, r->pc,
+            r->opcode, text, r->index, r->delay_timer, r->sound_timer);
+
+    /* only the values of VX and VF are in the record */
+    for (int i = 0; i < REGNUM; i++) {
+        if (!(r->changed & (1u << i)))
+            continue;
+
+        if (i == 0xF)
+            fprintf(stdout, " VF=%02X", r->vf);
+        else if (i == x)
+            fprintf(stdout, " V%X=%02X", i, r->vx);
+        else
+            fprintf(stdout, " V%X", i);
+    }
+
+    fputc('\n', stdout);
+}
+
+int main(int argc, char** argv)
+{
+    static struct trace_record records[RECORDS_PER_READ];
+    uint64_t mix[INST_UNKNOWN + 1] = {0};
+    struct filter f = {.to = UINT64_MAX, .pc_last = MEMSIZE - 1};
+    struct trace_header header;
+
+    if (argc < 2 || argv[1][0] == '-')
+        print_usage();
+
+    parse_args(argc, argv, &f);
+
+    FILE* fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "chip8-trace: %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, "C8RBTRCE", sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION || header.record_size != sizeof(struct trace_record)) {
+        fprintf(stderr, "chip8-trace: %s is not a trace of this version\n", argv[1]);
+        fclose(fp);
+        return 1;
+    }
+
+    uint64_t n = 0;
+    uint64_t passed = 0;
+    size_t count;
+
+    while (n <= f.to && (count = fread(records, sizeof(*records), RECORDS_PER_READ, fp)) > 0) {
+        for (size_t i = 0; i < count && n <= f.to; i++, n++) {
+            if (n < f.from)
+                continue;
+
+            struct ops op;
+            decode_opcode(records[i].opcode, &op);
+
+            if (!passes(&f, &records[i], op.handler))
+                continue;
+
+            passed++;
+            mix[op.handler]++;
+
+            if (!f.summary)
+                print_record(n, &records[i], op.X);
+        }
+    }
+
+    fclose(fp);
+
+    if (f.summary) {
+        fprintf(stdout, "%" PRIu64 " of %" PRIu64 " instructions\n", passed, n);
+
+        for (int i = 0; i <= INST_UNKNOWN; i++)
+            if (mix[i])
+                fprintf(stdout, "%s  %12" PRIu64 "\n", instruction_names[i], mix[i]);
+    }
+
+    return 0;
+}